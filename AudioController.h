@@ -1,24 +1,192 @@
 // AudioController.h
 #pragma once
-#include "SystemState.h"
+#include "BinaryProtocol.h"
+#include "SpscQueue.h"
 
+// Enlace con el Arduino Nano de audio por UART2 a 9600 baudios, con las
+// mismas tramas que el protocolo binario de Bluetooth.
+//
+// A 9600 baudios cada byte tarda ~1 ms, así que nada aquí espera al puerto:
+// las tramas se copian a un buffer circular y update() solo escribe lo que
+// cabe en la FIFO de la UART. Hay una orden en vuelo cada vez; si su ACK
+// no llega en ACK_TIMEOUT_MS se reenvía con la misma secuencia (el Nano
+// descarta los duplicados) hasta MAX_RETRIES veces.
+//
+// Se usa solo desde la tarea de comunicaciones, igual que la pista en
+// curso que informa el Nano: queda aquí y no en SystemState, que solo
+// escribe la tarea de iluminación.
 class AudioController {
+public:
+    struct Stats {
+        uint32_t sent;        // Órdenes confirmadas
+        uint32_t retries;     // Reenvíos por falta de ACK
+        uint32_t failures;    // Órdenes descartadas tras MAX_RETRIES
+        uint32_t dropped;     // Órdenes rechazadas con la cola llena
+    };
+
 private:
-    SystemState& state;
-    HardwareSerial* nanoSerial;
+    static const unsigned long ACK_TIMEOUT_MS = 150;  // ~20 ms de tramas + proceso del Nano
+    static const uint8_t MAX_RETRIES = 3;
+    static const uint8_t MAX_COMMAND_PAYLOAD = 1;
+    static const uint8_t MAX_FRAME_SIZE = 1 + BinaryProtocol::HEADER_SIZE + MAX_COMMAND_PAYLOAD + BinaryProtocol::CRC_SIZE;
+
+    struct Command {
+        uint8_t type;
+        uint8_t length;
+        uint8_t value;
+    };
+
+    HardwareSerial nanoSerial{2};
+
+    SpscQueue<Command, 8> commands;     // Órdenes pendientes de enviar
+    SpscQueue<uint8_t, 64> txBuffer;    // Bytes pendientes de escribir en la UART
+    BinaryProtocol::FrameDecoder decoder;
+
+    // Orden en vuelo
+    bool waitingAck = false;
+    Command current = {};
+    uint8_t sequence = 0;
+    uint8_t retries = 0;
+    unsigned long sentAt = 0;
+
+    bool linkUp = false;  // Último intercambio con el Nano correcto
+    uint8_t currentTrack = 1;
+    Stats stats = {};
+
+    bool enqueue(uint8_t type, uint8_t length, uint8_t value) {
+        Command command = {type, length, value};
+        if (!commands.push(command)) {
+            stats.dropped++;
+            return false;
+        }
+        return true;
+    }
+
+    void sendCurrent(unsigned long now) {
+        uint8_t frame[MAX_FRAME_SIZE];
+        uint16_t size = BinaryProtocol::buildFrame(frame, current.type, sequence,
+                                                   &current.value, current.length);
+        // Solo hay una trama en vuelo y cabe de sobra en el buffer
+        for (uint16_t i = 0; i < size; i++) {
+            txBuffer.push(frame[i]);
+        }
+        sentAt = now;
+        waitingAck = true;
+    }
+
+    void drainTx() {
+        int space = nanoSerial.availableForWrite();
+        uint8_t byte;
+        while (space-- > 0 && txBuffer.pop(byte)) {
+            nanoSerial.write(byte);
+        }
+    }
+
+    void handleFrame() {
+        using namespace BinaryProtocol;
+        const uint8_t* payload = decoder.payloadData();
+
+        switch (decoder.type()) {
+            case FRAME_ACK:
+                if (decoder.payloadLength() != ACK_PAYLOAD_SIZE) return;
+                if (!waitingAck || payload[0] != sequence) return;  // ACK tardío
+                waitingAck = false;
+                linkUp = true;
+                sequence++;
+                if (payload[1] == STATUS_OK || payload[1] == STATUS_DUPLICATE) {
+                    stats.sent++;
+                } else {
+                    stats.failures++;
+                }
+                break;
+            case FRAME_AUDIO_STATUS:
+                if (decoder.payloadLength() != 3) return;
+                currentTrack = payload[1];
+                linkUp = true;
+                break;
+        }
+    }
 
 public:
-    AudioController(SystemState& systemState) 
-        : state(systemState) {
-        nanoSerial = new HardwareSerial(2);
+    // onData se llama desde la tarea de eventos de la UART al recibir
+    void begin(void (*onData)() = nullptr) {
+        nanoSerial.begin(9600, SERIAL_8N1, 16, 17);
+        if (onData != nullptr) {
+            nanoSerial.onReceive(onData);
+        }
     }
     
-    void begin() {
-        nanoSerial->begin(9600, SERIAL_8N1, 16, 17);
+    // Órdenes para el Nano; devuelven false si la cola está llena
+    bool play(uint8_t track) {
+        return enqueue(BinaryProtocol::FRAME_AUDIO_PLAY, 1, track);
     }
-    
-    void setMode(uint8_t mode) {
-        state.audioMode = mode;
-        // Implementar comunicación con Arduino Nano
+
+    bool stop() {
+        return enqueue(BinaryProtocol::FRAME_AUDIO_STOP, 0, 0);
+    }
+
+    bool selectTrack(uint8_t track) {
+        return enqueue(BinaryProtocol::FRAME_AUDIO_TRACK, 1, track);
+    }
+
+    bool setVolume(uint8_t volume) {
+        return enqueue(BinaryProtocol::FRAME_AUDIO_VOLUME, 1, volume);
+    }
+
+    // Llamar en cada vuelta de la tarea de comunicaciones; nunca bloquea
+    void update() {
+        unsigned long now = millis();
+
+        decoder.checkTimeout(now);
+        while (nanoSerial.available()) {
+            if (decoder.feed((uint8_t)nanoSerial.read(), now) == BinaryProtocol::FrameDecoder::FRAME_OK) {
+                handleFrame();
+            }
+        }
+
+        if (waitingAck && now - sentAt >= ACK_TIMEOUT_MS) {
+            if (retries < MAX_RETRIES) {
+                retries++;
+                stats.retries++;
+                sendCurrent(now);
+            } else {
+                waitingAck = false;
+                linkUp = false;
+                sequence++;
+                stats.failures++;
+            }
+        }
+
+        if (!waitingAck && commands.pop(current)) {
+            retries = 0;
+            sendCurrent(now);
+        }
+
+        drainTx();
+    }
+
+    // ms hasta que update() tenga trabajo sin que llegue nada por la UART:
+    // 0 con bytes u órdenes por enviar, el plazo del ACK si hay una orden
+    // en vuelo y 0xFFFFFFFF si no hay nada pendiente
+    uint32_t nextDue(unsigned long now) const {
+        if (!txBuffer.isEmpty()) return 0;
+        if (waitingAck) {
+            unsigned long elapsed = now - sentAt;
+            return elapsed >= ACK_TIMEOUT_MS ? 0 : ACK_TIMEOUT_MS - elapsed;
+        }
+        return commands.isEmpty() ? 0xFFFFFFFF : 0;
+    }
+
+    bool isLinkUp() const {
+        return linkUp;
+    }
+
+    // Última pista informada por el Nano
+    uint8_t getCurrentTrack() const {
+        return currentTrack;
+    }
+
+    const Stats& getStats() const {
+        return stats;
     }
 };
@@ -0,0 +1,73 @@
+// AudioInput.h
+#pragma once
+#include <driver/i2s.h>
+
+// Entrada de audio analógica muestreada por el ADC interno a través de I2S
+// con DMA: el muestreo no usa CPU y read() solo copia lo que ya hay, sin
+// esperar. Entrega bloques de BLOCK_SIZE muestras con signo (sin continua).
+class AudioInput {
+public:
+    static const uint32_t SAMPLE_RATE = 12800;   // 256 muestras = 20 ms = 50 fps
+    static const uint16_t BLOCK_SIZE = 256;
+
+private:
+    static const i2s_port_t PORT = I2S_NUM_0;
+    static const adc1_channel_t CHANNEL = ADC1_CHANNEL_0;  // GPIO36
+
+    int16_t block[BLOCK_SIZE];
+    uint16_t filled = 0;
+    int32_t dcLevel = 2048 << 8;   // Media móvil en 24.8 de la señal de 12 bits
+    bool ready = false;
+
+public:
+    bool begin() {
+        i2s_config_t config = {};
+        config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+        config.sample_rate = SAMPLE_RATE;
+        config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+        config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+        config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+        config.dma_buf_count = 4;
+        config.dma_buf_len = BLOCK_SIZE;
+
+        ready = i2s_driver_install(PORT, &config, 0, nullptr) == ESP_OK &&
+                i2s_set_adc_mode(ADC_UNIT_1, CHANNEL) == ESP_OK &&
+                i2s_adc_enable(PORT) == ESP_OK;
+        return ready;
+    }
+
+    bool isReady() const {
+        return ready;
+    }
+
+    // Lee lo disponible sin bloquear. Devuelve el bloque cuando está
+    // completo (válido hasta la siguiente llamada) o nullptr
+    const int16_t* read() {
+        if (!ready) return nullptr;
+
+        uint16_t raw[64];
+        while (filled < BLOCK_SIZE) {
+            size_t wanted = BLOCK_SIZE - filled;
+            if (wanted > 64) wanted = 64;
+            size_t bytesRead = 0;
+            i2s_read(PORT, raw, wanted * sizeof(uint16_t), &bytesRead, 0);
+            size_t count = bytesRead / sizeof(uint16_t);
+            if (count == 0) return nullptr;
+
+            for (size_t i = 0; i < count; i++) {
+                int32_t sample = raw[i] & 0x0FFF;           // Los bits altos son el canal
+                dcLevel += sample - (dcLevel >> 8);          // Filtro de continua lento
+                int32_t centered = (sample << 8) - dcLevel;
+                // 12 bits a Q15; lejos de la continua (arranque, saturación
+                // del micro) se sale de rango y se recorta en vez de dar la vuelta
+                int32_t scaled = centered >> 4;
+                if (scaled > INT16_MAX) scaled = INT16_MAX;
+                if (scaled < INT16_MIN) scaled = INT16_MIN;
+                block[filled++] = (int16_t)scaled;
+            }
+        }
+
+        filled = 0;
+        return block;
+    }
+};
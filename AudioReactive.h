@@ -0,0 +1,131 @@
+// AudioReactive.h
+#pragma once
+#include "AudioInput.h"
+#include "FixedFft.h"
+#include "RGBController.h"
+
+// Modo de iluminación que sigue a la música (SystemState::audioMode).
+// Cada bloque de 20 ms pasa por la FFT, se agrupan los bins en bandas de
+// octava y cada canal de salida sigue una banda o la envolvente, con
+// ganancia automática y subida rápida / bajada lenta.
+class AudioReactive {
+public:
+    // Bandas de octava (bin = 50 Hz) y envolvente
+    enum Feature : uint8_t {
+        BAND_50, BAND_100, BAND_200, BAND_400, BAND_800, BAND_1600, BAND_3200,
+        ENVELOPE,
+        FEATURE_COUNT
+    };
+
+private:
+    static const uint16_t MIN_PEAK = 64;         // Por debajo es ruido: no se amplifica
+    static const uint8_t PEAK_DECAY_SHIFT = 7;   // El pico cae ~1/128 por bloque
+    static const uint8_t RELEASE_SHIFT = 3;      // Bajada de 1/8 por bloque
+
+    // Primer bin de cada banda; la banda i acaba donde empieza la i+1
+    static constexpr uint8_t BAND_START[BAND_3200 + 2] = {1, 2, 4, 8, 16, 32, 64, 128};
+
+    // Qué sigue cada canal: RGB1 graves/medios/agudos, RGB2 lo mismo
+    // desplazado una octava, auxiliares de graves a agudos
+    static constexpr uint8_t CHANNEL_FEATURE[] = {
+        BAND_50, BAND_400, BAND_3200,
+        BAND_100, BAND_800, BAND_1600,
+        ENVELOPE, BAND_100, BAND_400, BAND_1600, BAND_3200
+    };
+    static_assert(sizeof(CHANNEL_FEATURE) == NUM_LOGICAL_CHANNELS,
+                  "CHANNEL_FEATURE necesita una banda por canal lógico");
+
+    AudioInput& input;
+    RGBController& rgbController;
+    FixedFft fft;
+
+    uint32_t value[FEATURE_COUNT];   // Energía del último bloque
+    uint32_t peak[FEATURE_COUNT];    // Ganancia automática
+    uint16_t level[FEATURE_COUNT];   // Salida suavizada, nivel 8.8
+    uint32_t blocks = 0;
+
+    void analyze(const int16_t* samples) {
+        uint32_t envelope = 0;
+        for (uint16_t i = 0; i < FixedFft::SIZE; i++) {
+            envelope += samples[i] < 0 ? -samples[i] : samples[i];
+        }
+        value[ENVELOPE] = envelope / FixedFft::SIZE;
+
+        fft.load(samples);
+        fft.transform();
+
+        for (uint8_t band = BAND_50; band <= BAND_3200; band++) {
+            uint32_t sum = 0;
+            for (uint8_t bin = BAND_START[band]; bin < BAND_START[band + 1]; bin++) {
+                sum += fft.magnitude(bin);
+            }
+            value[band] = sum;
+        }
+    }
+
+    void updateLevels() {
+        for (uint8_t f = 0; f < FEATURE_COUNT; f++) {
+            uint32_t decayed = peak[f] - (peak[f] >> PEAK_DECAY_SHIFT);
+            peak[f] = value[f] > decayed ? value[f] : decayed;
+            if (peak[f] < MIN_PEAK) peak[f] = MIN_PEAK;
+
+            uint32_t target = ((uint64_t)value[f] * 0xFF00) / peak[f];
+            if (target >= level[f]) {
+                level[f] = target;
+            } else {
+                level[f] -= (level[f] - target) >> RELEASE_SHIFT;
+            }
+        }
+    }
+
+    void writeOutput() {
+        for (uint8_t ch = 0; ch < NUM_RGB; ch++) {
+            rgbController.setRGBLevels(ch,
+                level[CHANNEL_FEATURE[ch * 3]],
+                level[CHANNEL_FEATURE[ch * 3 + 1]],
+                level[CHANNEL_FEATURE[ch * 3 + 2]]);
+        }
+        for (uint8_t i = 0; i < NUM_AUX; i++) {
+            rgbController.setAuxiliaryLevel(i, level[CHANNEL_FEATURE[NUM_RGB * 3 + i]]);
+        }
+    }
+
+public:
+    AudioReactive(AudioInput& audioInput, RGBController& rgb)
+        : input(audioInput), rgbController(rgb) {
+        reset();
+    }
+
+    void reset() {
+        for (uint8_t f = 0; f < FEATURE_COUNT; f++) {
+            value[f] = 0;
+            peak[f] = MIN_PEAK;
+            level[f] = 0;
+        }
+    }
+
+    // Desde la tarea de iluminación en cada frame; solo trabaja cuando hay
+    // un bloque completo (50 veces por segundo). Devuelve si lo había.
+    bool update() {
+        const int16_t* samples = input.read();
+        if (samples == nullptr) return false;
+
+        analyze(samples);
+        updateLevels();
+        writeOutput();
+        blocks++;
+        return true;
+    }
+
+    uint32_t featureValue(Feature feature) const {
+        return value[feature];
+    }
+
+    uint16_t featureLevel(Feature feature) const {
+        return level[feature];
+    }
+
+    uint32_t getBlocks() const {
+        return blocks;
+    }
+};
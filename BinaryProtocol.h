@@ -0,0 +1,196 @@
+// BinaryProtocol.h
+#pragma once
+#include "Checksum.h"
+#include "LightingConfig.h"
+
+// Protocolo binario por tramas, usado junto al protocolo ASCII.
+//
+// Formato de trama (enteros en little-endian):
+//   0xA5 | tipo (1) | secuencia (1) | longitud (2) | datos (longitud) | CRC16 (2)
+// El CRC16 cubre desde el tipo hasta el final de los datos. El byte de
+// inicio 0xA5 no es ASCII, así que nunca se confunde con un comando de texto.
+//
+// Cada trama recibe exactamente una respuesta ACK con su número de secuencia
+// y un código de estado. Una trama repetida (misma secuencia que la última
+// aceptada) se vuelve a confirmar sin aplicarla otra vez. Una conexión
+// nueva o un PING empiezan sesión: la trama siguiente se acepta con
+// cualquier secuencia.
+namespace BinaryProtocol {
+    static const uint8_t FRAME_START = 0xA5;
+    static const uint8_t HEADER_SIZE = 4;     // tipo, secuencia, longitud
+    static const uint8_t CRC_SIZE = 2;
+    static const uint16_t MAX_PAYLOAD = 256;
+    static const unsigned long FRAME_TIMEOUT_MS = 500;
+
+    // Tipos de trama
+    static const uint8_t FRAME_PING = 0x01;
+    static const uint8_t FRAME_PHASE_BATCH = 0x10;  // Todas las fases en una trama
+    static const uint8_t FRAME_PHASE_FIELD = 0x11;  // fase, campo, valor (4)
+    static const uint8_t FRAME_ZONE = 0x12;         // zona (1): 0 = todas, 1..NUM_ZONES
+    static const uint8_t FRAME_TIMELINE_BEGIN = 0x20;      // período (4)
+    static const uint8_t FRAME_TIMELINE_KEYFRAMES = 0x21;  // cuenta + registros
+    static const uint8_t FRAME_TIMELINE_COMMIT = 0x22;     // keyframes enviados (2)
+    static const uint8_t FRAME_SET_CLOCK = 0x30;           // ms desde medianoche (4)
+
+    // Enlace UART con el Arduino Nano de audio (mismo formato de trama)
+    static const uint8_t FRAME_AUDIO_PLAY = 0x40;          // pista (1)
+    static const uint8_t FRAME_AUDIO_STOP = 0x41;
+    static const uint8_t FRAME_AUDIO_TRACK = 0x42;         // pista (1)
+    static const uint8_t FRAME_AUDIO_VOLUME = 0x43;        // volumen (1)
+    static const uint8_t FRAME_AUDIO_STATUS = 0x48;        // Nano: reproduciendo, pista, volumen
+    static const uint8_t FRAME_ACK = 0x80;
+
+    // Registro de fase dentro de FRAME_PHASE_BATCH (tras un byte de cuenta):
+    // fase, r1, g1, b1, r2, g2, b2, aux1..aux5, duración (4), transición (4).
+    // Los niveles son NUM_LOGICAL_CHANNELS bytes (LightingConfig.h)
+    static const uint8_t PHASE_OFFSET_LEVELS = 1;
+    static const uint8_t PHASE_OFFSET_DURATION = PHASE_OFFSET_LEVELS + NUM_LOGICAL_CHANNELS;
+    static const uint8_t PHASE_OFFSET_CROSSFADE = PHASE_OFFSET_DURATION + 4;
+    static const uint8_t PHASE_RECORD_SIZE = PHASE_OFFSET_CROSSFADE + 4;
+    static const uint8_t PHASE_RECORD_SIZE_EASING = PHASE_RECORD_SIZE + 1;  // + curva (Easing::Curve)
+
+    // Registro de keyframe dentro de FRAME_TIMELINE_KEYFRAMES (tras la cuenta):
+    // instante (4), transición (4), r1, g1, b1, r2, g2, b2, aux1..aux5,
+    // relés (bit i = relé i), etiqueta (fase o 255)
+    static const uint8_t KEYFRAME_OFFSET_LEVELS = 8;
+    static const uint8_t KEYFRAME_OFFSET_RELAYS = KEYFRAME_OFFSET_LEVELS + NUM_LOGICAL_CHANNELS;
+    static const uint8_t KEYFRAME_OFFSET_LABEL = KEYFRAME_OFFSET_RELAYS + 1;
+    static const uint8_t KEYFRAME_RECORD_SIZE = KEYFRAME_OFFSET_LABEL + 1;
+    static const uint8_t KEYFRAME_RECORD_SIZE_EASING = KEYFRAME_RECORD_SIZE + 1;  // + curva (Easing::Curve)
+
+    // Con la configuración de serie (2 RGB + 5 auxiliares) los registros
+    // siguen siendo los de siempre
+    static_assert(NUM_LOGICAL_CHANNELS != 11 || (PHASE_RECORD_SIZE == 20 && KEYFRAME_RECORD_SIZE == 21),
+                  "formato de registro cambiado");
+
+    // Códigos de estado del ACK
+    static const uint8_t STATUS_OK = 0;
+    static const uint8_t STATUS_BAD_CRC = 1;
+    static const uint8_t STATUS_BAD_LENGTH = 2;
+    static const uint8_t STATUS_UNKNOWN_TYPE = 3;
+    static const uint8_t STATUS_BAD_VALUE = 4;
+    static const uint8_t STATUS_DUPLICATE = 5;
+    static const uint8_t STATUS_BUSY = 6;          // Reintentar más tarde
+
+    inline uint32_t readU32(const uint8_t* data) {
+        return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+               ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    inline uint16_t readU16(const uint8_t* data) {
+        return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+    }
+
+    // Decodificador incremental: se le pasa byte a byte lo recibido
+    class FrameDecoder {
+    public:
+        enum Result {
+            NONE,        // Trama aún incompleta
+            FRAME_OK,    // Trama completa con CRC correcto
+            FRAME_BAD    // Trama completa con CRC o longitud incorrectos
+        };
+
+    private:
+        enum Stage { WAIT_START, HEADER, PAYLOAD, CRC };
+
+        Stage stage = WAIT_START;
+        uint8_t header[HEADER_SIZE];
+        uint8_t payload[MAX_PAYLOAD];
+        uint8_t crcBytes[CRC_SIZE];
+        uint16_t received = 0;
+        uint16_t length = 0;
+        bool lengthValid = true;
+        unsigned long lastByteTime = 0;
+
+    public:
+        bool isReceiving() const {
+            return stage != WAIT_START;
+        }
+
+        // Descarta una trama a medias si el emisor dejó de enviar
+        void checkTimeout(unsigned long now) {
+            if (stage != WAIT_START && now - lastByteTime > FRAME_TIMEOUT_MS) {
+                stage = WAIT_START;
+            }
+        }
+
+        Result feed(uint8_t byte, unsigned long now) {
+            lastByteTime = now;
+
+            switch (stage) {
+                case WAIT_START:
+                    if (byte == FRAME_START) {
+                        stage = HEADER;
+                        received = 0;
+                    }
+                    return NONE;
+
+                case HEADER:
+                    header[received++] = byte;
+                    if (received == HEADER_SIZE) {
+                        length = header[2] | (header[3] << 8);
+                        lengthValid = length <= MAX_PAYLOAD;
+                        received = 0;
+                        stage = length > 0 ? PAYLOAD : CRC;
+                    }
+                    return NONE;
+
+                case PAYLOAD:
+                    // Si la trama es demasiado larga se consume igualmente
+                    // para poder responder con STATUS_BAD_LENGTH
+                    if (received < MAX_PAYLOAD) {
+                        payload[received] = byte;
+                    }
+                    if (++received == length) {
+                        received = 0;
+                        stage = CRC;
+                    }
+                    return NONE;
+
+                case CRC:
+                    crcBytes[received++] = byte;
+                    if (received < CRC_SIZE) return NONE;
+                    stage = WAIT_START;
+                    if (!lengthValid) return FRAME_BAD;
+                    {
+                        uint16_t expected = crcBytes[0] | (crcBytes[1] << 8);
+                        uint16_t crc = crc16Ccitt(header, HEADER_SIZE);
+                        crc = crc16Ccitt(payload, length, crc);
+                        return crc == expected ? FRAME_OK : FRAME_BAD;
+                    }
+            }
+            return NONE;
+        }
+
+        uint8_t type() const { return header[0]; }
+        uint8_t sequence() const { return header[1]; }
+        uint16_t payloadLength() const { return length; }
+        bool payloadLengthValid() const { return lengthValid; }
+        const uint8_t* payloadData() const { return payload; }
+    };
+
+    static const uint8_t ACK_PAYLOAD_SIZE = 2;  // secuencia confirmada, estado
+    static const uint8_t ACK_FRAME_SIZE = 1 + HEADER_SIZE + ACK_PAYLOAD_SIZE + CRC_SIZE;
+
+    // Construye una trama en 'out' (de al menos 1 + HEADER_SIZE + length +
+    // CRC_SIZE bytes) y devuelve su tamaño
+    inline uint16_t buildFrame(uint8_t* out, uint8_t type, uint8_t sequence,
+                               const uint8_t* payload, uint16_t length) {
+        out[0] = FRAME_START;
+        out[1] = type;
+        out[2] = sequence;
+        out[3] = length & 0xFF;
+        out[4] = length >> 8;
+        memcpy(out + 1 + HEADER_SIZE, payload, length);
+        uint16_t crc = crc16Ccitt(out + 1, HEADER_SIZE + length);
+        out[1 + HEADER_SIZE + length] = crc & 0xFF;
+        out[2 + HEADER_SIZE + length] = crc >> 8;
+        return 1 + HEADER_SIZE + length + CRC_SIZE;
+    }
+
+    // Construye un ACK en 'out' (de al menos ACK_FRAME_SIZE bytes)
+    inline void buildAck(uint8_t* out, uint8_t sequence, uint8_t status) {
+        uint8_t payload[ACK_PAYLOAD_SIZE] = {sequence, status};
+        buildFrame(out, FRAME_ACK, sequence, payload, ACK_PAYLOAD_SIZE);
+    }
+}
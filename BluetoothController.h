@@ -1,231 +1,1012 @@
 //BluetoothController.h
 #pragma once
 #include <BluetoothSerial.h>
+#include <atomic>
 #include "SystemState.h"
 #include "RGBController.h"
 #include "AudioController.h"
-#include "PhaseController.h"  
+#include "LightingEngine.h"
+#include "ProfileLibrary.h"
+#include "BinaryProtocol.h"
+#include "LoopStats.h"
+#include "Easing.h"
+#include "Log.h"
 
 class BluetoothController {
+public:
+    // Descripción de un campo: nombre para los errores y rango válido. Un
+    // campo de texto se valida por longitud y queda en textField.
+    struct FieldSpec {
+        const char* name;
+        long minValue;
+        long maxValue;
+        bool text = false;
+    };
+
+    typedef void (BluetoothController::*CommandHandler)(const long* values);
+
+    // Entrada de la tabla de comandos. Con 'subcommand' la entrada solo
+    // coincide si el primer campo es esa palabra (p. ej. STATS,RESET).
+    // Los últimos 'optionalCount' campos pueden omitirse y valen 0; el
+    // manejador sabe cuántos llegaron por fieldsGiven.
+    struct CommandSpec {
+        const char* name;
+        const char* subcommand;
+        const FieldSpec* fields;
+        uint8_t fieldCount;
+        uint8_t optionalCount;
+        CommandHandler handler;
+    };
+
 private:
     BluetoothSerial SerialBT;
-    SystemState& state;
     RGBController& rgbController;
     AudioController& audioController;
-    PhaseController& phaseController;  // Añadimos esta referencia
+    LightingEngine& lightingEngine;  // Las órdenes de iluminación van por su cola
+    ProfileLibrary& profiles;
+    LoopStats& stats;
     
-    // Buffer para comandos
-    static const int MAX_COMMAND_LENGTH = 64;
+    // Buffer para comandos (CONFIG_FASE con duraciones largas pasa de 64)
+    static const int MAX_COMMAND_LENGTH = 96;
     char commandBuffer[MAX_COMMAND_LENGTH];
     int bufferIndex = 0;
+    bool commandOverflow = false;
+
+    // Modo binario: tramas con CRC y número de secuencia
+    BinaryProtocol::FrameDecoder frameDecoder;
+    int lastSequence = -1;  // Última secuencia aceptada (-1 = ninguna)
+
+    // Aviso de datos recibidos (despierta a la tarea de comunicaciones).
+    // Se llama desde la tarea de la pila Bluetooth.
+    static inline void (*dataCallback)() = nullptr;
+
+    // Conexión nueva: el cliente puede reiniciar sus secuencias, así que
+    // update() olvida la última aceptada antes de leer sus tramas
+    static inline std::atomic<bool> sessionOpened{false};
+
+    static void onSppEvent(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
+        if (event == ESP_SPP_SRV_OPEN_EVT) {
+            sessionOpened.store(true, std::memory_order_release);
+        }
+        if (event == ESP_SPP_DATA_IND_EVT && dataCallback != nullptr) {
+            dataCallback();
+        }
+    }
+
+    // Carga de línea de tiempo en curso (ASCII o binaria); se lleva aquí
+    // para poder validar cada keyframe y responder en el momento
+    bool timelineOpen = false;
+    uint32_t timelinePeriod = 0;
+    uint16_t timelineKeyframes = 0;
+    // Líneas KF rechazadas en la carga ASCII: KF_FIN no confirma una
+    // línea de tiempo a la que le faltan keyframes
+    uint16_t timelineRejected = 0;
+
+    // Última zona pedida con ZONA (0 = todas); GUARDAR toma sus fases
+    uint8_t zoneSelection = 0;
+
+    const char* textField = nullptr;
+    uint8_t fieldsGiven = 0;    // Campos recibidos en la orden en curso
+
+    static const uint8_t MAX_FIELDS = 16;
+    static const long MAX_DURATION = 0x7FFFFFFF;
+
+    // CONFIG_FASE y KF: un campo inicial, un nivel por canal lógico (RGB
+    // y auxiliares, LightingConfig.h), dos campos más y la curva opcional
+    static const uint8_t LEVEL_FIELDS_FIRST = 1;
+    static const uint8_t LEVEL_FIELDS_END = LEVEL_FIELDS_FIRST + NUM_LOGICAL_CHANNELS;
+    static const uint8_t LEVEL_COMMAND_FIELDS = LEVEL_FIELDS_END + 3;
+    static_assert(LEVEL_COMMAND_FIELDS <= MAX_FIELDS, "CONFIG_FASE no cabe en MAX_FIELDS");
 
 public:
-    // Modificamos el constructor para incluir PhaseController
-    BluetoothController(SystemState& systemState,
-                       RGBController& rgb,
-                       AudioController& audio,
-                       PhaseController& phase)
-        : state(systemState)
-        , rgbController(rgb)
-        , audioController(audio)
-        , phaseController(phase)
-    {
+    // Tabla de comandos ASCII; el simulador la recorre entera
+    static const CommandSpec* commandTable(uint8_t& count) {
+        static const FieldSpec FASE_FIELDS[] = {
+            {"fase", 0, NUM_PHASES - 1}
+        };
+        static const FieldSpec TRANSICION_FIELDS[] = {
+            {"origen", 0, NUM_PHASES - 1}, {"destino", 0, NUM_PHASES - 1}, {"duracion", 0, MAX_DURATION}
+        };
+        static const FieldSpec CONFIG_FASE_FIELDS[] = {
+            {"fase", 0, NUM_PHASES - 1},
+            {"r1", 0, 255}, {"g1", 0, 255}, {"b1", 0, 255},
+            {"r2", 0, 255}, {"g2", 0, 255}, {"b2", 0, 255},
+            {"aux1", 0, 255}, {"aux2", 0, 255}, {"aux3", 0, 255},
+            {"aux4", 0, 255}, {"aux5", 0, 255},
+            {"duracion", 0, MAX_DURATION}, {"transicion", 0, MAX_DURATION},
+            {"curva", 0, Easing::CURVE_COUNT - 1}
+        };
+        static_assert(sizeof(CONFIG_FASE_FIELDS) / sizeof(FieldSpec) == LEVEL_COMMAND_FIELDS,
+                      "CONFIG_FASE no coincide con LightingConfig.h");
+        static const FieldSpec KF_INICIO_FIELDS[] = {
+            {"periodo", 1, MAX_DURATION}
+        };
+        static const FieldSpec KF_FIELDS[] = {
+            {"tiempo", 0, MAX_DURATION},
+            {"r1", 0, 255}, {"g1", 0, 255}, {"b1", 0, 255},
+            {"r2", 0, 255}, {"g2", 0, 255}, {"b2", 0, 255},
+            {"aux1", 0, 255}, {"aux2", 0, 255}, {"aux3", 0, 255},
+            {"aux4", 0, 255}, {"aux5", 0, 255},
+            {"reles", 0, 3}, {"transicion", 0, MAX_DURATION},
+            {"curva", 0, Easing::CURVE_COUNT - 1}
+        };
+        static_assert(sizeof(KF_FIELDS) / sizeof(FieldSpec) == LEVEL_COMMAND_FIELDS,
+                      "KF no coincide con LightingConfig.h");
+        static const FieldSpec HORA_FIELDS[] = {
+            {"horas", 0, 23}, {"minutos", 0, 59}, {"segundos", 0, 59}
+        };
+        static const FieldSpec MODO_RELOJ_FIELDS[] = {
+            {"anclada", 0, 1}
+        };
+        static const FieldSpec PISTA_FIELDS[] = {
+            {"pista", 1, 255}
+        };
+        static const FieldSpec VOLUMEN_FIELDS[] = {
+            {"volumen", 0, 30}
+        };
+        static const FieldSpec MODO_AUDIO_FIELDS[] = {
+            {"modo", AUDIO_MODE_SCHEDULE, AUDIO_MODE_REACTIVE}
+        };
+        static const FieldSpec AJUSTE_FASE_FIELDS[] = {
+            {"fase", 0, NUM_PHASES - 1}, {"campo", 0, PHASE_FIELD_COUNT - 1}, {"valor", 0, MAX_DURATION}
+        };
+        static const FieldSpec FPS_FIELDS[] = {
+            {"hz", FrameClock::MIN_RATE_HZ, FrameClock::MAX_RATE_HZ}
+        };
+        static const FieldSpec ZONA_FIELDS[] = {
+            {"zona", 0, NUM_ZONES}
+        };
+        static const FieldSpec PERFIL_FIELDS[] = {
+            {"perfil", 1, ProfileLibrary::MAX_PROFILES}
+        };
+        static const FieldSpec PERFIL_USAR_FIELDS[] = {
+            {"perfil", 1, ProfileLibrary::MAX_PROFILES}, {"transicion", 0, MAX_DURATION}
+        };
+        static const FieldSpec PERFIL_GUARDAR_FIELDS[] = {
+            {"perfil", 1, ProfileLibrary::MAX_PROFILES}, {"nombre", 1, ProfileLibrary::NAME_SIZE - 1, true}
+        };
+        static const FieldSpec LOG_FIELDS[] = {
+            {"nivel", Log::LEVEL_ERROR, Log::LEVEL_DEBUG}
+        };
+        static const CommandSpec COMMANDS[] = {
+            {"FASE", nullptr, FASE_FIELDS, 1, 0, &BluetoothController::cmdFase},
+            {"TRANSICION", nullptr, TRANSICION_FIELDS, 3, 0, &BluetoothController::cmdTransicion},
+            {"CONFIG_FASE", nullptr, CONFIG_FASE_FIELDS, LEVEL_COMMAND_FIELDS, 1, &BluetoothController::cmdConfigFase},
+            {"AJUSTE_FASE", nullptr, AJUSTE_FASE_FIELDS, 3, 0, &BluetoothController::cmdAjusteFase},
+            {"ZONA", nullptr, ZONA_FIELDS, 1, 0, &BluetoothController::cmdZona},
+            {"PLAY", nullptr, nullptr, 0, 0, &BluetoothController::cmdPlay},
+            {"STOP", nullptr, nullptr, 0, 0, &BluetoothController::cmdStop},
+            {"KF_INICIO", nullptr, KF_INICIO_FIELDS, 1, 0, &BluetoothController::cmdKfInicio},
+            {"KF", nullptr, KF_FIELDS, LEVEL_COMMAND_FIELDS, 1, &BluetoothController::cmdKf},
+            {"KF_FIN", nullptr, nullptr, 0, 0, &BluetoothController::cmdKfFin},
+            {"TIMELINE", "FASES", nullptr, 0, 0, &BluetoothController::cmdTimelineFases},
+            {"HORA", nullptr, HORA_FIELDS, 3, 0, &BluetoothController::cmdHora},
+            {"MODO_RELOJ", nullptr, MODO_RELOJ_FIELDS, 1, 0, &BluetoothController::cmdModoReloj},
+            {"AUDIO", "PLAY", PISTA_FIELDS, 1, 0, &BluetoothController::cmdAudioPlay},
+            {"AUDIO", "STOP", nullptr, 0, 0, &BluetoothController::cmdAudioStop},
+            {"AUDIO", "PISTA", PISTA_FIELDS, 1, 0, &BluetoothController::cmdAudioPista},
+            {"AUDIO", "VOLUMEN", VOLUMEN_FIELDS, 1, 0, &BluetoothController::cmdAudioVolumen},
+            {"MODO_AUDIO", nullptr, MODO_AUDIO_FIELDS, 1, 0, &BluetoothController::cmdModoAudio},
+            {"FPS", nullptr, FPS_FIELDS, 1, 0, &BluetoothController::cmdFps},
+            {"PERFIL", "LISTA", nullptr, 0, 0, &BluetoothController::cmdPerfilLista},
+            {"PERFIL", "GUARDAR", PERFIL_GUARDAR_FIELDS, 2, 0, &BluetoothController::cmdPerfilGuardar},
+            {"PERFIL", "USAR", PERFIL_USAR_FIELDS, 2, 1, &BluetoothController::cmdPerfilUsar},
+            {"PERFIL", "SIGUIENTE", PERFIL_FIELDS, 1, 0, &BluetoothController::cmdPerfilSiguiente},
+            {"PERFIL", "BORRAR", PERFIL_FIELDS, 1, 0, &BluetoothController::cmdPerfilBorrar},
+            {"LOG", nullptr, LOG_FIELDS, 1, 0, &BluetoothController::cmdLog},
+            {"STATS", "RESET", nullptr, 0, 0, &BluetoothController::cmdStatsReset},
+            {"STATS", nullptr, nullptr, 0, 0, &BluetoothController::cmdStats},
+        };
+        count = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+        return COMMANDS;
     }
-    
-    void begin() {
-        SerialBT.begin("Better_Controller");
+
+private:
+    static const CommandSpec* findCommand(char* const* tokens, uint8_t tokenCount) {
+        uint8_t count;
+        const CommandSpec* commands = commandTable(count);
+
+        // Gana la primera coincidencia: las entradas con subcomando van antes
+        for (uint8_t i = 0; i < count; i++) {
+            const CommandSpec& spec = commands[i];
+            if (strcmp(spec.name, tokens[0]) != 0) continue;
+            if (spec.subcommand == nullptr) return &spec;
+            if (tokenCount > 1 && strcmp(spec.subcommand, tokens[1]) == 0) return &spec;
+        }
+        return nullptr;
     }
-    
-    /*void processCommand(const String& command) {
-        // Dividimos el comando en partes
-        int commaIndex = command.indexOf(',');
-        if (commaIndex == -1) return;
-        
-        String cmd = command.substring(0, commaIndex);
-        String params = command.substring(commaIndex + 1);
-        
-        if (cmd == "FASE") {
-            // FASE,<número>
-            int fase = params.toInt();
-            if (fase >= 0 && fase < 5) {
-                phaseController.applyPhase(fase);
-                SerialBT.println("Fase aplicada: " + String(fase));
+
+    // Convierte un campo con strtol y comprueba formato y rango
+    bool parseField(const char* token, uint8_t index, const FieldSpec& field, long& value) {
+        if (field.text) {
+            value = strlen(token);
+            if (value < field.minValue || value > field.maxValue) {
+                SerialBT.printf("Error: campo %d (%s) debe tener %ld-%ld caracteres\n",
+                                index + 1, field.name, field.minValue, field.maxValue);
+                return false;
             }
+            textField = token;
+            return true;
         }
-        else if (cmd == "TRANSICION") {
-            // TRANSICION,<origen>,<destino>,<duración>
-            int comma1 = params.indexOf(',');
-            int comma2 = params.indexOf(',', comma1 + 1);
-            if (comma1 == -1 || comma2 == -1) return;
-            
-            int faseOrigen = params.substring(0, comma1).toInt();
-            int faseDestino = params.substring(comma1 + 1, comma2).toInt();
-            int duracion = params.substring(comma2 + 1).toInt();
-            
-            if (faseOrigen >= 0 && faseOrigen < 5 && 
-                faseDestino >= 0 && faseDestino < 5) {
-                phaseController.startTransition(faseOrigen, faseDestino, duracion);
-                SerialBT.println("Iniciando transición");
-            }
+        char* end = nullptr;
+        value = strtol(token, &end, 10);
+        if (end == token || *end != '\0') {
+            SerialBT.printf("Error: campo %d (%s) no es numerico\n", index + 1, field.name);
+            return false;
         }
-    }*/
-    void processCommand(const String& command) {
-    // Dividimos el comando en partes
-    /*int commaIndex = command.indexOf(',');
-    if (commaIndex == -1) return;
-    
-    String cmd = command.substring(0, commaIndex);
-    String params = command.substring(commaIndex + 1);*/
-    int firstComma = command.indexOf(',');
-    if (firstComma == -1) return;
-    
-    String cmd = command.substring(0, firstComma);
-    String params = command.substring(firstComma + 1);
+        if (value < field.minValue || value > field.maxValue) {
+            SerialBT.printf("Error: campo %d (%s) fuera de rango %ld-%ld\n",
+                            index + 1, field.name, field.minValue, field.maxValue);
+            return false;
+        }
+        return true;
+    }
 
-    //String cmd;
-    
-    /*if (firstComma == -1) {
-        // Si no hay coma, el comando completo es el nombre
-        cmd = command;
-    } else {
-        cmd = command.substring(0, firstComma);
-    }*/
-    
-    // Eliminamos espacios en blanco
-    //cmd.trim();
-    //if (firstComma == -1) return;
-    
-    //String cmd = command.substring(0, firstComma);
-    //String params = command.substring(firstComma + 1);  // Definimos params aquí
-    
-    if (cmd == "FASE") {
+    // Envía una orden a la tarea de iluminación e informa si la cola está llena
+    bool post(const LightingCommand& command) {
+        if (!lightingEngine.post(command)) {
+            SerialBT.println("Error: cola de iluminacion llena");
+            return false;
+        }
+        return true;
+    }
+
+    // Manejadores de comandos; reciben los campos ya validados
+    void cmdFase(const long* values) {
         // FASE,<número>
-        int fase = params.toInt();
-        if (fase >= 0 && fase < 5) {
-            phaseController.applyPhase(fase);
-            SerialBT.println("Fase aplicada: " + String(fase));
+        LightingCommand command = LightingCommand::make(LightingCommand::APPLY_PHASE);
+        command.phase = (uint8_t)values[0];
+        if (post(command)) {
+            SerialBT.printf("Fase aplicada: %ld\n", values[0]);
         }
     }
-    else if (cmd == "TRANSICION") {
+
+    void cmdTransicion(const long* values) {
         // TRANSICION,<origen>,<destino>,<duración>
-        int comma1 = params.indexOf(',');
-        int comma2 = params.indexOf(',', comma1 + 1);
-        if (comma1 == -1 || comma2 == -1) return;
-        
-        int faseOrigen = params.substring(0, comma1).toInt();
-        int faseDestino = params.substring(comma1 + 1, comma2).toInt();
-        int duracion = params.substring(comma2 + 1).toInt();
-        
-        if (faseOrigen >= 0 && faseOrigen < 5 && 
-            faseDestino >= 0 && faseDestino < 5) {
-            phaseController.startTransition(faseOrigen, faseDestino, duracion);
+        LightingCommand command = LightingCommand::make(LightingCommand::START_TRANSITION);
+        command.phase = (uint8_t)values[0];
+        command.targetPhase = (uint8_t)values[1];
+        command.duration = (uint32_t)values[2];
+        if (post(command)) {
             SerialBT.println("Iniciando transición");
         }
     }
-    else if (cmd == "CONFIG_FASE") {
-        // Creamos un array para almacenar todos los valores
-        int valores[14];
-        int index = 0;
-        String tempParams = params;
-        
-        // Procesamos cada valor separado por comas
-        while (index < 14 && tempParams.length() > 0) {
-            int nextComma = tempParams.indexOf(',');
-            if (nextComma == -1) {
-                // Último valor
-                valores[index++] = tempParams.toInt();
+
+    void cmdConfigFase(const long* values) {
+        // CONFIG_FASE,<fase>,<r1>,<g1>,<b1>,<r2>,<g2>,<b2>,<aux1..aux5>,<duración>,<transición>[,<curva>]
+        if (!lightingEngine.canPost(2)) {
+            SerialBT.println("Error: cola de iluminacion llena");
+            return;
+        }
+
+        LightingCommand command = LightingCommand::make(LightingCommand::CONFIGURE_PHASE);
+        const long* levels = values + LEVEL_FIELDS_FIRST;
+        command.phase = (uint8_t)values[0];                 // fase
+        for (int i = 0; i < NUM_RGB * 3; i++) {
+            command.rgb[i / 3][i % 3] = (uint8_t)levels[i];  // RGB1, RGB2...
+        }
+        for (int i = 0; i < NUM_AUX; i++) {
+            command.auxiliary[i] = (uint8_t)levels[NUM_RGB * 3 + i];  // auxiliares
+        }
+        command.duration = (uint32_t)values[LEVEL_FIELDS_END];       // duración
+        command.crossFade = (uint32_t)values[LEVEL_FIELDS_END + 1];  // tiempo de transición
+        command.easing = (uint8_t)values[LEVEL_FIELDS_END + 2];      // curva (0 = lineal)
+
+        SerialBT.println("Configurando fase:");
+        SerialBT.printf("Fase: %ld\n", values[0]);
+        for (int i = 0; i < NUM_RGB; i++) {
+            SerialBT.printf("RGB%d: %ld,%ld,%ld\n", i + 1, levels[i * 3], levels[i * 3 + 1], levels[i * 3 + 2]);
+        }
+
+        // Los cambios seguidos se agrupan en una sola escritura
+        post(command);
+        post(LightingCommand::make(LightingCommand::REQUEST_SAVE));
+        SerialBT.println("Fase configurada");
+    }
+
+    // Cambio de un solo campo; lo comparten AJUSTE_FASE y FRAME_PHASE_FIELD
+    uint8_t postPhaseField(uint8_t phase, uint8_t field, uint32_t value) {
+        using namespace BinaryProtocol;
+        if (phase >= NUM_PHASES || field >= PHASE_FIELD_COUNT) return STATUS_BAD_VALUE;
+        if (field < PHASE_FIELD_DURATION && value > 255) return STATUS_BAD_VALUE;
+        if (field == PHASE_FIELD_EASING && value >= Easing::CURVE_COUNT) return STATUS_BAD_VALUE;
+        if (!lightingEngine.canPost(2)) return STATUS_BUSY;
+
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_PHASE_FIELD);
+        command.phase = phase;
+        command.field = field;
+        command.value = value;
+        lightingEngine.post(command);
+        lightingEngine.post(LightingCommand::make(LightingCommand::REQUEST_SAVE));
+        return STATUS_OK;
+    }
+
+    void cmdAjusteFase(const long* values) {
+        // AJUSTE_FASE,<fase>,<campo>,<valor>: campos 0-10 niveles (r1, g1, b1,
+        // r2, g2, b2, aux1..aux5), 11 duración, 12 transición, 13 curva
+        switch (postPhaseField((uint8_t)values[0], (uint8_t)values[1], (uint32_t)values[2])) {
+            case BinaryProtocol::STATUS_OK:
+                SerialBT.printf("Fase %ld: campo %ld = %ld\n", values[0], values[1], values[2]);
+                break;
+            case BinaryProtocol::STATUS_BUSY:
+                SerialBT.println("Error: cola de iluminacion llena");
+                break;
+            default:
+                SerialBT.printf("Error: valor %ld fuera de rango para el campo %ld\n", values[2], values[1]);
+                break;
+        }
+    }
+
+    void cmdPlay(const long* values) {
+        LOG_DEBUG("Comando PLAY recibido");
+        if (post(LightingCommand::make(LightingCommand::START_SEQUENCE))) {
+            SerialBT.println("Iniciando secuencia");
+        }
+    }
+
+    void cmdStop(const long* values) {
+        if (post(LightingCommand::make(LightingCommand::STOP_SEQUENCE))) {
+            SerialBT.println("Secuencia detenida");
+        }
+    }
+
+    // Zona a la que van las siguientes órdenes de fases y línea de tiempo:
+    // 0 = todas, 1..NUM_ZONES. Común a ZONA y FRAME_ZONE. No se cambia con
+    // una carga de línea de tiempo a medias, que acabaría repartida.
+    uint8_t selectZone(uint8_t zone) {
+        using namespace BinaryProtocol;
+        if (zone > NUM_ZONES || timelineOpen) return STATUS_BAD_VALUE;
+        LightingCommand command = LightingCommand::make(LightingCommand::SELECT_ZONE);
+        command.phase = zone == 0 ? ZONE_ALL : zone - 1;
+        if (!lightingEngine.post(command)) return STATUS_BUSY;
+        zoneSelection = zone;
+        return STATUS_OK;
+    }
+
+    void cmdZona(const long* values) {
+        // ZONA,<0 = todas | 1..NUM_ZONES>
+        switch (selectZone((uint8_t)values[0])) {
+            case BinaryProtocol::STATUS_OK:
+                if (values[0] == 0) {
+                    SerialBT.println("Zona: todas");
+                } else {
+                    SerialBT.printf("Zona: %ld\n", values[0]);
+                }
+                break;
+            case BinaryProtocol::STATUS_BUSY:
+                SerialBT.println("Error: cola de iluminacion llena");
+                break;
+            default:
+                SerialBT.println("Error: linea de tiempo sin cerrar (KF_FIN)");
+                break;
+        }
+    }
+
+    // Comunes a la carga ASCII y binaria
+    bool beginTimelineUpload(uint32_t period) {
+        LightingCommand command = LightingCommand::make(LightingCommand::TIMELINE_BEGIN);
+        command.duration = period;
+        if (!lightingEngine.post(command)) return false;
+        timelineOpen = true;
+        timelinePeriod = period;
+        timelineKeyframes = 0;
+        timelineRejected = 0;
+        return true;
+    }
+
+    uint8_t postKeyframe(const Timeline::Keyframe& keyframe) {
+        using namespace BinaryProtocol;
+        if (!timelineOpen) return STATUS_BAD_VALUE;
+        if (keyframe.time >= timelinePeriod) return STATUS_BAD_VALUE;
+        if (timelineKeyframes >= Timeline::MAX_KEYFRAMES) return STATUS_BAD_LENGTH;
+
+        LightingCommand command = LightingCommand::make(LightingCommand::TIMELINE_KEYFRAME);
+        command.keyframe = keyframe;
+        if (!lightingEngine.post(command)) return STATUS_BUSY;
+        timelineKeyframes++;
+        return STATUS_OK;
+    }
+
+    bool commitTimelineUpload() {
+        if (!lightingEngine.post(LightingCommand::make(LightingCommand::TIMELINE_COMMIT))) {
+            return false;
+        }
+        timelineOpen = false;
+        return true;
+    }
+
+    void cmdKfInicio(const long* values) {
+        // KF_INICIO,<periodo ms>
+        if (beginTimelineUpload((uint32_t)values[0])) {
+            SerialBT.printf("Linea de tiempo de %ld ms\n", values[0]);
+        } else {
+            SerialBT.println("Error: cola de iluminacion llena");
+        }
+    }
+
+    void cmdKf(const long* values) {
+        // KF,<tiempo>,<r1>,<g1>,<b1>,<r2>,<g2>,<b2>,<aux1..aux5>,<reles>,<transicion>[,<curva>]
+        Timeline::Keyframe keyframe = {};
+        const long* levels = values + LEVEL_FIELDS_FIRST;
+        keyframe.time = (uint32_t)values[0];
+        for (int i = 0; i < NUM_RGB * 3; i++) {
+            keyframe.rgb[i / 3][i % 3] = (uint8_t)levels[i];
+        }
+        for (int i = 0; i < NUM_AUX; i++) {
+            keyframe.auxiliary[i] = (uint8_t)levels[NUM_RGB * 3 + i];
+        }
+        keyframe.relays = (uint8_t)values[LEVEL_FIELDS_END];
+        keyframe.crossFade = (uint32_t)values[LEVEL_FIELDS_END + 1];
+        keyframe.label = Timeline::NO_LABEL;
+        keyframe.easing = (uint8_t)values[LEVEL_FIELDS_END + 2];
+
+        uint8_t status = postKeyframe(keyframe);
+        if (status != BinaryProtocol::STATUS_OK && timelineOpen) {
+            timelineRejected++;
+        }
+        switch (status) {
+            case BinaryProtocol::STATUS_OK:
+                break;
+            case BinaryProtocol::STATUS_BUSY:
+                SerialBT.println("Error: cola de iluminacion llena");
+                break;
+            case BinaryProtocol::STATUS_BAD_LENGTH:
+                SerialBT.printf("Error: maximo %d keyframes\n", Timeline::MAX_KEYFRAMES);
+                break;
+            default:
+                if (!timelineOpen) {
+                    SerialBT.println("Error: KF sin KF_INICIO");
+                } else {
+                    SerialBT.printf("Error: tiempo fuera del periodo %lu\n", (unsigned long)timelinePeriod);
+                }
+                break;
+        }
+    }
+
+    void cmdKfFin(const long* values) {
+        if (!timelineOpen) {
+            SerialBT.println("Error: KF_FIN sin KF_INICIO");
+            return;
+        }
+        if (timelineRejected > 0) {
+            // La línea de tiempo en preparación se descarta con el próximo KF_INICIO
+            timelineOpen = false;
+            SerialBT.printf("Error: %u keyframes rechazados, linea de tiempo descartada\n", timelineRejected);
+            return;
+        }
+        if (commitTimelineUpload()) {
+            SerialBT.printf("Linea de tiempo enviada: %u keyframes\n", timelineKeyframes);
+        } else {
+            SerialBT.println("Error: cola de iluminacion llena");
+        }
+    }
+
+    void cmdTimelineFases(const long* values) {
+        // Vuelve a la secuencia Alba, Día, Tarde, Noche de las fases
+        if (post(LightingCommand::make(LightingCommand::TIMELINE_FROM_PHASES))) {
+            timelineOpen = false;
+            SerialBT.println("Linea de tiempo desde las fases");
+        }
+    }
+
+    void cmdHora(const long* values) {
+        // HORA,<hh>,<mm>,<ss>
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_CLOCK);
+        command.duration = (uint32_t)((values[0] * 60 + values[1]) * 60 + values[2]) * 1000;
+        if (post(command)) {
+            SerialBT.printf("Hora: %02ld:%02ld:%02ld\n", values[0], values[1], values[2]);
+        }
+    }
+
+    void cmdModoReloj(const long* values) {
+        // MODO_RELOJ,<1 = según la hora del día | 0 = desde PLAY>
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_CLOCK_MODE);
+        command.phase = (uint8_t)values[0];
+        if (post(command)) {
+            SerialBT.println(values[0] ? "Secuencia segun la hora del dia" : "Secuencia desde PLAY");
+        }
+    }
+
+    // Órdenes para el Nano de audio; se envían en segundo plano
+    void replyAudio(bool queued, const char* message) {
+        SerialBT.println(queued ? message : "Error: cola de audio llena");
+    }
+
+    void cmdAudioPlay(const long* values) {
+        // AUDIO,PLAY,<pista>
+        replyAudio(audioController.play((uint8_t)values[0]), "Audio: reproduciendo");
+    }
+
+    void cmdAudioStop(const long* values) {
+        replyAudio(audioController.stop(), "Audio: detenido");
+    }
+
+    void cmdAudioPista(const long* values) {
+        // AUDIO,PISTA,<pista>
+        replyAudio(audioController.selectTrack((uint8_t)values[0]), "Audio: pista seleccionada");
+    }
+
+    void cmdAudioVolumen(const long* values) {
+        // AUDIO,VOLUMEN,<0-30>
+        replyAudio(audioController.setVolume((uint8_t)values[0]), "Audio: volumen ajustado");
+    }
+
+    void cmdModoAudio(const long* values) {
+        // MODO_AUDIO,<0 = programa | 1 = reactivo a la música>
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_AUDIO_MODE);
+        command.phase = (uint8_t)values[0];
+        if (post(command)) {
+            SerialBT.println(values[0] == AUDIO_MODE_REACTIVE ? "Modo audio: reactivo" : "Modo audio: programa");
+        }
+    }
+
+    void cmdFps(const long* values) {
+        // FPS,<hz>: más frames = fundidos más suaves y más tráfico I2C
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_FRAME_RATE);
+        command.duration = (uint32_t)values[0];
+        if (post(command)) {
+            SerialBT.printf("Frecuencia de frames: %ld Hz\n", values[0]);
+        }
+    }
+
+    // Resultado de una operación de ProfileLibrary; true si ha ido bien
+    bool replyProfile(ProfileLibrary::Result result, long profile) {
+        switch (result) {
+            case ProfileLibrary::OK:
+                return true;
+            case ProfileLibrary::NOT_FOUND:
+                SerialBT.printf("Error: perfil %ld vacio\n", profile);
+                break;
+            case ProfileLibrary::BUSY:
+                SerialBT.println("Error: cambio de perfil en curso, reintentar");
                 break;
+            case ProfileLibrary::FAILED:
+                SerialBT.println("Error: fallo de SPIFFS en la biblioteca de perfiles");
+                break;
+        }
+        return false;
+    }
+
+    void cmdPerfilLista(const long* values) {
+        // PERFIL,LISTA: '*' = en uso en alguna zona, '>' = precargado como siguiente
+        SystemState snapshot;
+        lightingEngine.readSnapshot(snapshot);
+        SerialBT.printf("Perfiles: %u de %u\n", profiles.count(), ProfileLibrary::MAX_PROFILES);
+        for (uint8_t i = 0; i < ProfileLibrary::MAX_PROFILES; i++) {
+            if (!profiles.isUsed(i)) continue;
+            bool active = false;
+            for (const auto& zone : snapshot.zones) {
+                if (zone.profile == i) active = true;
             }
-            String valorStr = tempParams.substring(0, nextComma);
-            valores[index++] = valorStr.toInt();
-            tempParams = tempParams.substring(nextComma + 1);
-        }
-        
-        // Verificamos que tenemos todos los valores
-        /*if (index == 13) {
-            uint8_t auxValues[5] = {
-                (uint8_t)valores[7], 
-                (uint8_t)valores[8], 
-                (uint8_t)valores[9], 
-                (uint8_t)valores[10], 
-                (uint8_t)valores[11]
-            };
-            
-            // Añadimos debug para verificar los valores
-            SerialBT.println("Configurando fase:");
-            SerialBT.printf("Fase: %d\n", valores[0]);
-            SerialBT.printf("RGB1: %d,%d,%d\n", valores[1], valores[2], valores[3]);
-            SerialBT.printf("RGB2: %d,%d,%d\n", valores[4], valores[5], valores[6]);
-            
-            phaseController.configurePhase(
-                valores[0],                    // fase
-                valores[1], valores[2], valores[3],  // RGB1
-                valores[4], valores[5], valores[6],  // RGB2
-                auxValues,                          // auxiliares
-                valores[12]                         // duración
-            );
-        }*/ 
-        
-        if (index == 14) {  // Ahora esperamos 14 valores (13 anteriores + tiempo de transición)
-        uint8_t auxValues[5] = {
-            (uint8_t)valores[7], 
-            (uint8_t)valores[8], 
-            (uint8_t)valores[9], 
-            (uint8_t)valores[10], 
-            (uint8_t)valores[11]
-        };
-            SerialBT.println("Configurando fase:");
-            SerialBT.printf("Fase: %d\n", valores[0]);
-            SerialBT.printf("RGB1: %d,%d,%d\n", valores[1], valores[2], valores[3]);
-            SerialBT.printf("RGB2: %d,%d,%d\n", valores[4], valores[5], valores[6]);
-            //SerialBT.printf("T: %d\n", valores[12]/1000);
-        
-        phaseController.configurePhase(
-            (uint8_t)valores[0],                    // fase
-            (uint8_t)valores[1],                    // r1
-            (uint8_t)valores[2],                    // g1
-            (uint8_t)valores[3],                    // b1
-            (uint8_t)valores[4],                    // r2
-            (uint8_t)valores[5],                    // g2
-            (uint8_t)valores[6],                    // b2
-            auxValues,                              // auxiliares
-            (unsigned long)valores[12],             // duración
-            (unsigned long)valores[13]              // tiempo de transición
-        );
-        
-        // Guardamos la configuración después de cada cambio
-        phaseController.saveToSPIFFS();
-        SerialBT.println("Fase configurada y guardada");
-    }else {
-            SerialBT.println("Error: Número incorrecto de parámetros");
-        }
-    }
-    else if (cmd == "PLAY") {
-        Serial.println("Comando PLAY recibido");  // Debug
-        phaseController.startSequence();
-        SerialBT.println("Iniciando secuencia");
-        Serial.printf("Estado de secuencia: %s\n", 
-                     phaseController.isSequenceRunning() ? "Activa" : "Inactiva");
-    }
-    else if (cmd == "STOP") {
-        phaseController.stopSequence();
-        SerialBT.println("Secuencia detenida");
-    }
-}
+            SerialBT.printf("%c%u: %s%s\n", active ? '*' : (profiles.getNext() == i ? '>' : ' '),
+                            i + 1, profiles.name(i), profiles.isCached(i) ? " (en memoria)" : "");
+        }
+    }
+
+    void cmdPerfilGuardar(const long* values) {
+        // PERFIL,GUARDAR,<perfil>,<nombre>: las fases de la zona elegida (la 1 si son todas)
+        uint8_t zone = zoneSelection == 0 ? 0 : zoneSelection - 1;
+        if (replyProfile(profiles.save((uint8_t)(values[0] - 1), textField, zone), values[0])) {
+            SerialBT.printf("Perfil %ld guardado: %s\n", values[0], textField);
+        }
+    }
+
+    void cmdPerfilUsar(const long* values) {
+        // PERFIL,USAR,<perfil>[,<transicion ms>] en la zona elegida; sin
+        // transición se usa ProfileLibrary::DEFAULT_FADE_MS y 0 cambia al instante
+        uint32_t fade = fieldsGiven > 1 ? (uint32_t)values[1] : ProfileLibrary::DEFAULT_FADE_MS;
+        if (replyProfile(profiles.select((uint8_t)(values[0] - 1), fade), values[0])) {
+            SerialBT.printf("Perfil en uso: %ld (%s)\n", values[0], profiles.name(values[0] - 1));
+        }
+    }
+
+    void cmdPerfilSiguiente(const long* values) {
+        // PERFIL,SIGUIENTE,<perfil>: se mantiene decodificado para cambiar sin leer el fichero
+        if (replyProfile(profiles.setNext((uint8_t)(values[0] - 1)), values[0])) {
+            SerialBT.printf("Perfil siguiente: %ld\n", values[0]);
+        }
+    }
+
+    void cmdPerfilBorrar(const long* values) {
+        // PERFIL,BORRAR,<perfil>
+        if (replyProfile(profiles.remove((uint8_t)(values[0] - 1)), values[0])) {
+            SerialBT.printf("Perfil %ld borrado\n", values[0]);
+        }
+    }
+
+    void cmdLog(const long* values) {
+        // LOG,<nivel>: 0 errores, 1 avisos, 2 información, 3 depuración.
+        // Por encima de LOG_LEVEL no hay nada compilado que mostrar.
+        Log::instance().setLevel((uint8_t)values[0]);
+        SerialBT.printf("Nivel de registro: %ld (compilado hasta %d)\n", values[0], LOG_LEVEL);
+    }
+
+    // STATS: latencias por subsistema (us) e histograma, y contadores
+    void cmdStats(const long* values) {
+        SerialBT.println("Subsistema: n min/media/max us");
+        for (int i = 0; i < LoopStats::SUBSYSTEM_COUNT; i++) {
+            LoopStats::Subsystem subsystem = (LoopStats::Subsystem)i;
+            const LoopStats::Timing& timing = stats.timing(subsystem);
+            if (timing.count == 0) {
+                SerialBT.printf("%s: sin datos\n", LoopStats::name(subsystem));
+                continue;
+            }
+            SerialBT.printf("%s: %lu %lu/%lu/%lu\n", LoopStats::name(subsystem),
+                            (unsigned long)timing.count,
+                            (unsigned long)LoopStats::cyclesToMicros(timing.minCycles),
+                            (unsigned long)LoopStats::cyclesToMicros(timing.totalCycles / timing.count),
+                            (unsigned long)LoopStats::cyclesToMicros(timing.maxCycles));
+
+            // Histograma: "<N ns: cuenta" para cada cubo con datos
+            for (uint8_t b = 0; b < LoopStats::HISTOGRAM_BUCKETS; b++) {
+                if (timing.histogram[b] == 0) continue;
+                SerialBT.printf("  <%lu ns: %lu\n",
+                                (unsigned long)LoopStats::cyclesToNanos(1UL << b),
+                                (unsigned long)timing.histogram[b]);
+            }
+        }
+        SerialBT.printf("I2C: %lu TFT: %lu BT: %lu bytes\n",
+                        (unsigned long)stats.counter(LoopStats::I2C_WRITES),
+                        (unsigned long)stats.counter(LoopStats::TFT_REDRAWS),
+                        (unsigned long)stats.counter(LoopStats::BT_BYTES));
+
+        const FrameClock::Stats& clock = lightingEngine.getFrameClockStats();
+        SerialBT.printf("Frames: %u Hz, %lu frames, %lu fuera de plazo (peor %lu us), %lu ticks saltados\n",
+                        lightingEngine.getFrameRate(), (unsigned long)clock.frames,
+                        (unsigned long)clock.missedDeadlines, (unsigned long)clock.worstLatenessUs,
+                        (unsigned long)clock.skippedTicks);
+
+        Log& log = Log::instance();
+        SerialBT.printf("Log: nivel %u, %lu escritos, %lu perdidos\n", log.getLevel(),
+                        (unsigned long)log.getWritten(), (unsigned long)log.getDropped());
+        SerialBT.printf("Perfiles: %u guardados, %lu cambios desde memoria, %lu con lectura, %lu lecturas\n",
+                        profiles.count(), (unsigned long)profiles.getHits(),
+                        (unsigned long)profiles.getMisses(), (unsigned long)profiles.getReads());
+
+        SerialBT.printf("Arranque: primera luz a los %lu ms, listo a los %lu ms\n",
+                        (unsigned long)stats.bootTime(LoopStats::BOOT_FIRST_LIGHT),
+                        (unsigned long)stats.bootTime(LoopStats::BOOT_READY));
+
+        // Tiempo despierta de cada tarea desde el último STATS,RESET
+        SerialBT.printf("Despierta en %lu s:", (unsigned long)(stats.measuredTime() / 1000));
+        for (int i = 0; i < LoopStats::TASK_COUNT; i++) {
+            LoopStats::Task task = (LoopStats::Task)i;
+            uint16_t duty = stats.dutyCycle(task);
+            SerialBT.printf(" %s %u.%u%% (%lu esperas)", LoopStats::taskName(task),
+                            duty / 10, duty % 10, (unsigned long)stats.sleepCount(task));
+        }
+        SerialBT.println();
+
+        // La configuración de placas no cambia tras el arranque
+        const PWMOutput& output = rgbController.getOutput();
+        uint8_t channels = rgbController.getChannelMap().getPhysicalCount();
+        SerialBT.printf("PWM: %u placas, %u canales, I2C %lu kHz, max %lu fps\n",
+                        output.getBoardCount(), channels,
+                        (unsigned long)(output.getBusHz() / 1000),
+                        (unsigned long)PWMOutput::achievableFrameRate(channels, output.getBusHz()));
+    }
+
+    void cmdStatsReset(const long* values) {
+        stats.requestReset();
+        lightingEngine.requestFrameClockReset();
+        SerialBT.println("Estadisticas reiniciadas");
+    }
+
+    void sendAck(uint8_t sequence, uint8_t status) {
+        uint8_t frame[BinaryProtocol::ACK_FRAME_SIZE];
+        BinaryProtocol::buildAck(frame, sequence, status);
+        SerialBT.write(frame, sizeof(frame));
+    }
+
+    // Carga de varias fases en una sola trama. Se validan todos los
+    // registros antes de aplicar ninguno y se guarda una sola vez.
+    uint8_t handlePhaseBatch(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+
+        // Los registros llevan o no el byte de curva; la longitud lo indica
+        if (length < 1) return STATUS_BAD_LENGTH;
+        uint8_t count = data[0];
+        if (count == 0 || count > NUM_PHASES) return STATUS_BAD_LENGTH;
+        uint8_t recordSize;
+        if (length == 1 + count * PHASE_RECORD_SIZE) {
+            recordSize = PHASE_RECORD_SIZE;
+        } else if (length == 1 + count * PHASE_RECORD_SIZE_EASING) {
+            recordSize = PHASE_RECORD_SIZE_EASING;
+        } else {
+            return STATUS_BAD_LENGTH;
+        }
+
+        const uint8_t* records = data + 1;
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t* record = records + i * recordSize;
+            if (record[0] >= NUM_PHASES) return STATUS_BAD_VALUE;
+            if (recordSize == PHASE_RECORD_SIZE_EASING && record[PHASE_RECORD_SIZE] >= Easing::CURVE_COUNT) {
+                return STATUS_BAD_VALUE;
+            }
+        }
+
+        // El lote entra entero en la cola o no entra
+        if (!lightingEngine.canPost(count + 1)) return STATUS_BUSY;
+
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t* record = records + i * recordSize;
+            LightingCommand command = LightingCommand::make(LightingCommand::CONFIGURE_PHASE);
+            command.phase = record[0];
+            memcpy(command.rgb, record + PHASE_OFFSET_LEVELS, sizeof(command.rgb));
+            memcpy(command.auxiliary, record + PHASE_OFFSET_LEVELS + sizeof(command.rgb),
+                   sizeof(command.auxiliary));
+            command.duration = readU32(record + PHASE_OFFSET_DURATION);
+            command.crossFade = readU32(record + PHASE_OFFSET_CROSSFADE);
+            if (recordSize == PHASE_RECORD_SIZE_EASING) {
+                command.easing = record[PHASE_RECORD_SIZE];  // curva
+            }
+            lightingEngine.post(command);
+        }
+
+        lightingEngine.post(LightingCommand::make(LightingCommand::REQUEST_SAVE));
+        return STATUS_OK;
+    }
+
+    uint8_t handlePhaseField(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+        if (length != 6) return STATUS_BAD_LENGTH;
+        return postPhaseField(data[0], data[1], readU32(data + 2));
+    }
+
+    uint8_t handleTimelineBegin(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+        if (length != 4) return STATUS_BAD_LENGTH;
+        uint32_t period = readU32(data);
+        if (period == 0) return STATUS_BAD_VALUE;
+        return beginTimelineUpload(period) ? STATUS_OK : STATUS_BUSY;
+    }
+
+    // Varios keyframes por trama; como en el lote de fases, se validan
+    // todos antes de encolar ninguno
+    uint8_t handleTimelineKeyframes(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+
+        if (length < 1) return STATUS_BAD_LENGTH;
+        uint8_t count = data[0];
+        if (count == 0) return STATUS_BAD_LENGTH;
+        uint8_t recordSize;
+        if (length == 1 + count * KEYFRAME_RECORD_SIZE) {
+            recordSize = KEYFRAME_RECORD_SIZE;
+        } else if (length == 1 + count * KEYFRAME_RECORD_SIZE_EASING) {
+            recordSize = KEYFRAME_RECORD_SIZE_EASING;
+        } else {
+            return STATUS_BAD_LENGTH;
+        }
+        if (!timelineOpen) return STATUS_BAD_VALUE;
+        if (timelineKeyframes + count > Timeline::MAX_KEYFRAMES) return STATUS_BAD_LENGTH;
+
+        const uint8_t* records = data + 1;
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t* record = records + i * recordSize;
+            if (readU32(record) >= timelinePeriod) return STATUS_BAD_VALUE;
+            uint8_t label = record[KEYFRAME_OFFSET_LABEL];
+            if (record[KEYFRAME_OFFSET_RELAYS] > 3) return STATUS_BAD_VALUE;
+            if (label >= NUM_PHASES && label != Timeline::NO_LABEL) return STATUS_BAD_VALUE;
+            if (recordSize == KEYFRAME_RECORD_SIZE_EASING && record[KEYFRAME_RECORD_SIZE] >= Easing::CURVE_COUNT) {
+                return STATUS_BAD_VALUE;
+            }
+        }
+
+        if (!lightingEngine.canPost(count)) return STATUS_BUSY;
+
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t* record = records + i * recordSize;
+            Timeline::Keyframe keyframe = {};
+            keyframe.time = readU32(record);             // instante
+            keyframe.crossFade = readU32(record + 4);    // transición
+            memcpy(keyframe.rgb, record + KEYFRAME_OFFSET_LEVELS, sizeof(keyframe.rgb));
+            memcpy(keyframe.auxiliary, record + KEYFRAME_OFFSET_LEVELS + sizeof(keyframe.rgb),
+                   sizeof(keyframe.auxiliary));
+            keyframe.relays = record[KEYFRAME_OFFSET_RELAYS];
+            keyframe.label = record[KEYFRAME_OFFSET_LABEL];
+            if (recordSize == KEYFRAME_RECORD_SIZE_EASING) {
+                keyframe.easing = record[KEYFRAME_RECORD_SIZE];
+            }
+            postKeyframe(keyframe);
+        }
+        return STATUS_OK;
+    }
+
+    // El commit lleva los keyframes que el emisor cree haber enviado:
+    // si no coinciden, se ha perdido una trama y no se aplica
+    uint8_t handleTimelineCommit(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+        if (length != 2) return STATUS_BAD_LENGTH;
+        if (!timelineOpen || readU16(data) != timelineKeyframes) return STATUS_BAD_VALUE;
+        return commitTimelineUpload() ? STATUS_OK : STATUS_BUSY;
+    }
+
+    uint8_t handleZone(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+        if (length != 1) return STATUS_BAD_LENGTH;
+        return selectZone(data[0]);
+    }
+
+    uint8_t handleSetClock(const uint8_t* data, uint16_t length) {
+        using namespace BinaryProtocol;
+        if (length != 4) return STATUS_BAD_LENGTH;
+        LightingCommand command = LightingCommand::make(LightingCommand::SET_CLOCK);
+        command.duration = readU32(data);
+        if (command.duration >= WallClock::DAY_MS) return STATUS_BAD_VALUE;
+        return lightingEngine.post(command) ? STATUS_OK : STATUS_BUSY;
+    }
+
+    void handleFrame(BinaryProtocol::FrameDecoder::Result result) {
+        using namespace BinaryProtocol;
+
+        uint8_t sequence = frameDecoder.sequence();
+        if (result == FrameDecoder::FRAME_BAD) {
+            sendAck(sequence, frameDecoder.payloadLengthValid() ? STATUS_BAD_CRC : STATUS_BAD_LENGTH);
+            return;
+        }
+
+        // PING abre sesión: se confirma siempre y la trama siguiente se
+        // acepta sea cual sea su secuencia
+        if (frameDecoder.type() == FRAME_PING) {
+            lastSequence = -1;
+            sendAck(sequence, STATUS_OK);
+            return;
+        }
+
+        // Reenvío de una trama ya aplicada: se confirma sin repetirla
+        if (sequence == lastSequence) {
+            sendAck(sequence, STATUS_DUPLICATE);
+            return;
+        }
+
+        uint8_t status;
+        switch (frameDecoder.type()) {
+            case FRAME_PHASE_BATCH:
+                status = handlePhaseBatch(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_PHASE_FIELD:
+                status = handlePhaseField(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_ZONE:
+                status = handleZone(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_TIMELINE_BEGIN:
+                status = handleTimelineBegin(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_TIMELINE_KEYFRAMES:
+                status = handleTimelineKeyframes(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_TIMELINE_COMMIT:
+                status = handleTimelineCommit(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            case FRAME_SET_CLOCK:
+                status = handleSetClock(frameDecoder.payloadData(), frameDecoder.payloadLength());
+                break;
+            default:
+                status = STATUS_UNKNOWN_TYPE;
+                break;
+        }
+
+        if (status == STATUS_OK) {
+            lastSequence = sequence;
+        }
+        sendAck(sequence, status);
+    }
+
+public:
+    BluetoothController(RGBController& rgb,
+                       AudioController& audio,
+                       LightingEngine& lighting,
+                       ProfileLibrary& profileLibrary,
+                       LoopStats& loopStats)
+        : rgbController(rgb)
+        , audioController(audio)
+        , lightingEngine(lighting)
+        , profiles(profileLibrary)
+        , stats(loopStats)
+    {
+    }
+    
+    void begin(void (*onData)() = nullptr) {
+        dataCallback = onData;
+        SerialBT.register_callback(onSppEvent);
+        SerialBT.begin("Better_Controller");
+    }
+
+    // Procesa una línea terminada en '\0'. Se trocea en el propio buffer
+    // (las comas pasan a ser '\0') y no se reserva memoria dinámica.
+    void processCommand(char* line) {
+        char* tokens[MAX_FIELDS + 1] = {};
+        uint8_t tokenCount = 0;
+
+        char* cursor = line;
+        tokens[tokenCount++] = cursor;
+        while (*cursor != '\0') {
+            if (*cursor == ',') {
+                *cursor = '\0';
+                if (tokenCount > MAX_FIELDS) {
+                    SerialBT.println("Error: demasiados campos");
+                    return;
+                }
+                tokens[tokenCount++] = cursor + 1;
+            }
+            cursor++;
+        }
+
+        // Se admite "PLAY" y "PLAY," indistintamente
+        if (tokenCount == 2 && tokens[1][0] == '\0') {
+            tokenCount = 1;
+        }
+
+        const CommandSpec* spec = findCommand(tokens, tokenCount);
+        if (spec == nullptr) {
+            SerialBT.printf("Error: comando desconocido %.20s\n", tokens[0]);
+            return;
+        }
+
+        uint8_t firstField = spec->subcommand ? 2 : 1;
+        uint8_t fieldCount = tokenCount - firstField;
+        uint8_t requiredCount = spec->fieldCount - spec->optionalCount;
+        if (fieldCount < requiredCount || fieldCount > spec->fieldCount) {
+            if (spec->optionalCount > 0) {
+                SerialBT.printf("Error: %s espera %d-%d campos, recibidos %d\n",
+                                spec->name, requiredCount, spec->fieldCount, fieldCount);
+            } else {
+                SerialBT.printf("Error: %s espera %d campos, recibidos %d\n",
+                                spec->name, spec->fieldCount, fieldCount);
+            }
+            return;
+        }
+
+        // Se validan todos los campos para informar de cada error
+        long values[MAX_FIELDS] = {};
+        bool valid = true;
+        for (uint8_t i = 0; i < fieldCount; i++) {
+            if (!parseField(tokens[firstField + i], i, spec->fields[i], values[i])) {
+                valid = false;
+            }
+        }
+        if (!valid) return;
+
+        fieldsGiven = fieldCount;
+        (this->*(spec->handler))(values);
+    }
     
     void update() {
+        unsigned long now = millis();
+        frameDecoder.checkTimeout(now);
+        if (sessionOpened.exchange(false, std::memory_order_acquire)) {
+            lastSequence = -1;
+        }
+
         // Lee comandos Bluetooth
         while (SerialBT.available()) {
             char c = SerialBT.read();
+            stats.count(LoopStats::BT_BYTES);
+
+            // Una trama binaria empieza por 0xA5 al principio de línea
+            if (frameDecoder.isReceiving() ||
+                (bufferIndex == 0 && (uint8_t)c == BinaryProtocol::FRAME_START)) {
+                BinaryProtocol::FrameDecoder::Result result = frameDecoder.feed(c, now);
+                if (result != BinaryProtocol::FrameDecoder::NONE) {
+                    handleFrame(result);
+                }
+                continue;
+            }
             
             if (c == '\n' || c == '\r') {
-                if (bufferIndex > 0) {
+                if (commandOverflow) {
+                    SerialBT.println("Error: comando demasiado largo");
+                } else if (bufferIndex > 0) {
                     commandBuffer[bufferIndex] = '\0';
-                    processCommand(String(commandBuffer));
-                    bufferIndex = 0;
+                    processCommand(commandBuffer);
                 }
+                bufferIndex = 0;
+                commandOverflow = false;
             } else if (bufferIndex < MAX_COMMAND_LENGTH - 1) {
                 commandBuffer[bufferIndex++] = c;
+            } else {
+                commandOverflow = true;
             }
         }
     }
@@ -0,0 +1,83 @@
+// ChannelMap.h
+#pragma once
+#include "PWMOutput.h"
+#include "LightingConfig.h"
+
+// Reparto de los canales lógicos (RGB1, RGB2 y auxiliares) entre los canales
+// físicos de todas las placas PCA9685. Un canal lógico puede alimentar
+// cualquier número de canales físicos (por ejemplo la misma tira RGB
+// repetida en varias placas); cada canal físico pertenece a un solo canal
+// lógico.
+//
+// Se guarda como listas enlazadas en dos tablas fijas: first[lógico] es el
+// primer canal físico y next[físico] el siguiente del mismo canal lógico.
+class ChannelMap {
+public:
+    static const uint8_t RGB_BASE = 0;             // R, G, B de cada tira seguidos
+    static const uint8_t AUX_BASE = NUM_RGB * 3;   // Auxiliares a continuación
+    static const uint8_t LOGICAL_CHANNELS = NUM_LOGICAL_CHANNELS;
+    static const uint8_t NONE = 0xFF;
+
+private:
+    uint8_t first[LOGICAL_CHANNELS];
+    uint8_t next[PWMOutput::MAX_CHANNELS];
+    uint8_t owner[PWMOutput::MAX_CHANNELS];        // Canal lógico de cada físico
+    uint8_t physicalCount = 0;
+
+public:
+    ChannelMap() {
+        clear();
+    }
+
+    void clear() {
+        memset(first, NONE, sizeof(first));
+        memset(next, NONE, sizeof(next));
+        memset(owner, NONE, sizeof(owner));
+        physicalCount = 0;
+    }
+
+    // Asigna un canal físico (placa, canal 0-15) a un canal lógico.
+    // Falla si el canal físico no existe o ya está asignado
+    bool assign(uint8_t logical, uint8_t board, uint8_t channel) {
+        if (logical >= LOGICAL_CHANNELS || board >= PWMOutput::MAX_BOARDS ||
+            channel >= PWMOutput::CHANNELS_PER_BOARD) {
+            return false;
+        }
+        uint8_t physical = board * PWMOutput::CHANNELS_PER_BOARD + channel;
+        if (owner[physical] != NONE) return false;
+
+        owner[physical] = logical;
+        next[physical] = first[logical];
+        first[logical] = physical;
+        physicalCount++;
+        return true;
+    }
+
+    // Disposición por defecto: los canales lógicos en los primeros canales
+    // de cada placa, la misma escena repetida en todas
+    void useMirroredLayout(uint8_t boards) {
+        clear();
+        for (uint8_t board = 0; board < boards && board < PWMOutput::MAX_BOARDS; board++) {
+            for (uint8_t logical = 0; logical < LOGICAL_CHANNELS; logical++) {
+                assign(logical, board, logical);
+            }
+        }
+    }
+
+    // Recorrido: for (p = firstPhysical(l); p != NONE; p = nextPhysical(p))
+    uint8_t firstPhysical(uint8_t logical) const {
+        return logical < LOGICAL_CHANNELS ? first[logical] : NONE;
+    }
+
+    uint8_t nextPhysical(uint8_t physical) const {
+        return next[physical];
+    }
+
+    uint8_t logicalOf(uint8_t physical) const {
+        return physical < PWMOutput::MAX_CHANNELS ? owner[physical] : NONE;
+    }
+
+    uint8_t getPhysicalCount() const {
+        return physicalCount;
+    }
+};
@@ -0,0 +1,27 @@
+// Checksum.h
+#pragma once
+
+// CRC-16/CCITT-FALSE (polinomio 0x1021, valor inicial 0xFFFF).
+// Se puede encadenar pasando el resultado anterior como 'crc'.
+inline uint16_t crc16Ccitt(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// CRC-32 (IEEE 802.3, polinomio reflejado 0xEDB88320), encadenable igual
+// que crc16Ccitt: el valor devuelto ya lleva aplicada la inversión final.
+inline uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
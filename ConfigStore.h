@@ -0,0 +1,157 @@
+// ConfigStore.h
+#pragma once
+#include <SPIFFS.h>
+#include <FS.h>
+#include "Checksum.h"
+
+using fs::File;
+
+// Persistencia de un bloque de configuración en SPIFFS.
+//
+// - El fichero lleva una cabecera con número mágico, versión, tamaño y CRC32.
+// - Se escribe primero en un temporal y luego se renombra, de modo que un
+//   corte de luz deja el fichero anterior o el nuevo, nunca uno a medias.
+// - Las peticiones de guardado se agrupan: solo se escribe cuando pasa un
+//   periodo sin cambios (QUIET_PERIOD_MS).
+class ConfigStore {
+public:
+    enum LoadResult {
+        LOAD_OK,        // Cargado y verificado
+        LOAD_MIGRATED,  // Formato antiguo aceptado; conviene reescribirlo
+        LOAD_MISSING,   // No hay fichero
+        LOAD_INVALID    // Fichero corrupto o de una versión desconocida
+    };
+
+    static const unsigned long QUIET_PERIOD_MS = 2000;
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t payloadSize;
+        uint32_t crc;
+    };
+
+    const char* path;
+    const char* tempPath;
+    uint32_t magic;
+    uint16_t version;
+
+    bool dirty = false;
+    unsigned long lastChange = 0;
+
+    // Lee y verifica un bloque de hasta 'maxSize' bytes; 'size' devuelve el real
+    bool readValid(const char* filePath, uint8_t* data, size_t maxSize, size_t& size, uint16_t fileVersion) {
+        File file = SPIFFS.open(filePath, "r");
+        if (!file) return false;
+
+        Header header;
+        bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  header.magic == magic &&
+                  header.version == fileVersion &&
+                  header.headerSize == sizeof(Header) &&
+                  header.payloadSize <= maxSize &&
+                  file.read(data, header.payloadSize) == header.payloadSize &&
+                  crc32(data, header.payloadSize) == header.crc;
+        file.close();
+        size = ok ? header.payloadSize : 0;
+        return ok;
+    }
+
+public:
+    ConfigStore(const char* filePath, const char* tempFilePath, uint32_t fileMagic, uint16_t fileVersion)
+        : path(filePath), tempPath(tempFilePath), magic(fileMagic), version(fileVersion) {}
+
+    // Carga en 'data'. Si el fichero no es válido, 'data' puede quedar
+    // modificado y el llamante debe volver a sus valores por defecto.
+    // 'legacySize' es el tamaño del formato anterior sin cabecera (0 = ninguno).
+    // 'previousVersion' acepta además esa versión con cabecera y el mismo
+    // tamaño (0 = ninguna). Ambos casos devuelven LOAD_MIGRATED.
+    LoadResult load(uint8_t* data, size_t size, size_t legacySize = 0, uint16_t previousVersion = 0) {
+        size_t loaded = 0;
+        LoadResult result = loadVariable(data, size, loaded);
+        if (result == LOAD_OK && loaded != size) {
+            return LOAD_INVALID;
+        }
+        if (result != LOAD_INVALID) {
+            return result;
+        }
+
+        size_t previousSize = 0;
+        if (previousVersion != 0 && readValid(path, data, size, previousSize, previousVersion) &&
+            previousSize == size) {
+            return LOAD_MIGRATED;
+        }
+
+        // Formato antiguo: los bytes en crudo, sin cabecera
+        if (legacySize == size) {
+            File file = SPIFFS.open(path, "r");
+            if (file && file.size() == legacySize) {
+                bool ok = file.read(data, size) == size;
+                file.close();
+                if (ok) return LOAD_MIGRATED;
+            } else if (file) {
+                file.close();
+            }
+        }
+
+        return LOAD_INVALID;
+    }
+
+    // Carga de tamaño variable (hasta 'maxSize'); 'size' devuelve lo leído
+    LoadResult loadVariable(uint8_t* data, size_t maxSize, size_t& size) {
+        if (readValid(path, data, maxSize, size, version)) {
+            return LOAD_OK;
+        }
+
+        // Un corte entre borrar el fichero y renombrar el temporal deja
+        // solo el temporal, que ya está completo y verificado
+        if (!SPIFFS.exists(path)) {
+            if (SPIFFS.exists(tempPath) && readValid(tempPath, data, maxSize, size, version)) {
+                SPIFFS.rename(tempPath, path);
+                return LOAD_OK;
+            }
+            return LOAD_MISSING;
+        }
+
+        return LOAD_INVALID;
+    }
+
+    // Escritura inmediata: temporal + renombrado
+    bool save(const uint8_t* data, size_t size) {
+        Header header = {magic, version, sizeof(Header), (uint32_t)size, crc32(data, size)};
+
+        File file = SPIFFS.open(tempPath, "w");
+        if (!file) return false;
+        bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  file.write(data, size) == size;
+        file.close();
+        if (!ok) {
+            SPIFFS.remove(tempPath);
+            return false;
+        }
+
+        // SPIFFS no renombra sobre un fichero existente
+        if (SPIFFS.exists(path)) {
+            SPIFFS.remove(path);
+        }
+        ok = SPIFFS.rename(tempPath, path);
+        if (ok) dirty = false;
+        return ok;
+    }
+
+    // Marca un cambio; el guardado real se hace en isSaveDue()/save()
+    void requestSave(unsigned long now) {
+        dirty = true;
+        lastChange = now;
+    }
+
+    bool isDirty() const {
+        return dirty;
+    }
+
+    bool isSaveDue(unsigned long now) const {
+        return dirty && now - lastChange >= QUIET_PERIOD_MS;
+    }
+};
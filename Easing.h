@@ -0,0 +1,129 @@
+// Easing.h
+#pragma once
+
+// Curvas de aceleración para los fundidos. Cada curva es una tabla de 65
+// puntos en Q16 generada en tiempo de compilación (en flash, sin powf/expf
+// en tiempo de ejecución); entre puntos se interpola linealmente, así que
+// aplicar una curva cuesta lo mismo en cada frame: una búsqueda y un
+// producto.
+namespace Easing {
+    enum Curve : uint8_t {
+        LINEAR,
+        SMOOTHSTEP,
+        EASE_IN_OUT_CUBIC,
+        SIGMOID,
+        SUNRISE,        // Logarítmica: sube rápido y se suaviza al final
+        CURVE_COUNT
+    };
+
+    static const uint8_t TABLE_BITS = 6;
+    static const uint8_t TABLE_POINTS = (1 << TABLE_BITS) + 1;
+    static const uint8_t FRAC_BITS = 16 - TABLE_BITS;
+
+    // exp() y log() evaluables en tiempo de compilación (solo para generar
+    // las tablas; la precisión sobra para 16 bits)
+    constexpr double constExp(double x) {
+        int halvings = 0;
+        while (x > 0.5 || x < -0.5) {
+            x /= 2;
+            halvings++;
+        }
+        double term = 1.0;
+        double sum = 1.0;
+        for (int i = 1; i < 20; i++) {
+            term *= x / i;
+            sum += term;
+        }
+        while (halvings-- > 0) {
+            sum *= sum;
+        }
+        return sum;
+    }
+
+    constexpr double constLog(double y) {
+        int exponent = 0;
+        while (y > 2.0) {
+            y /= 2;
+            exponent++;
+        }
+        while (y < 1.0) {
+            y *= 2;
+            exponent--;
+        }
+        double z = (y - 1) / (y + 1);
+        double power = z;
+        double sum = 0.0;
+        for (int i = 1; i < 60; i += 2) {
+            sum += power / i;
+            power *= z * z;
+        }
+        return exponent * 0.6931471805599453 + 2 * sum;
+    }
+
+    constexpr double sigmoid(double x) {
+        return 1.0 / (1.0 + constExp(-10.0 * (x - 0.5)));
+    }
+
+    // Valor de la curva en x (0-1)
+    constexpr double evaluate(Curve curve, double x) {
+        switch (curve) {
+            case SMOOTHSTEP:
+                return x * x * (3 - 2 * x);
+            case EASE_IN_OUT_CUBIC:
+                return x < 0.5 ? 4 * x * x * x
+                               : 1 - (2 - 2 * x) * (2 - 2 * x) * (2 - 2 * x) / 2;
+            case SIGMOID:
+                return (sigmoid(x) - sigmoid(0)) / (sigmoid(1) - sigmoid(0));
+            case SUNRISE:
+                return constLog(1 + 9 * x) / constLog(10);
+            default:
+                return x;
+        }
+    }
+
+    // La curva LINEAR no necesita tabla
+    struct EasingLut {
+        uint16_t value[CURVE_COUNT - 1][TABLE_POINTS];
+    };
+
+    constexpr EasingLut buildEasingLut() {
+        EasingLut lut = {};
+        for (int c = 1; c < CURVE_COUNT; c++) {
+            for (int i = 0; i < TABLE_POINTS; i++) {
+                double y = evaluate((Curve)c, (double)i / (TABLE_POINTS - 1));
+                if (y < 0) y = 0;
+                if (y > 1) y = 1;
+                lut.value[c - 1][i] = (uint16_t)(y * 65535 + 0.5);
+            }
+        }
+        return lut;
+    }
+
+    constexpr bool isMonotonic(const EasingLut& lut) {
+        for (int c = 0; c < CURVE_COUNT - 1; c++) {
+            if (lut.value[c][0] != 0 || lut.value[c][TABLE_POINTS - 1] != 65535) return false;
+            for (int i = 1; i < TABLE_POINTS; i++) {
+                if (lut.value[c][i] < lut.value[c][i - 1]) return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr EasingLut LUT = buildEasingLut();
+
+    static_assert(isMonotonic(LUT), "Las curvas deben ir de 0 a 1 sin retroceder");
+
+    // Progreso Q16 (0-65536) a progreso Q16 con la curva aplicada.
+    // Una curva desconocida se trata como lineal.
+    inline uint32_t apply(uint8_t curve, uint32_t progressQ16) {
+        if (curve == LINEAR || curve >= CURVE_COUNT) return progressQ16;
+        if (progressQ16 >= 65536) return 65536;
+
+        const uint16_t* table = LUT.value[curve - 1];
+        uint32_t index = progressQ16 >> FRAC_BITS;
+        int32_t frac = progressQ16 & ((1 << FRAC_BITS) - 1);
+        int32_t low = table[index];
+        int32_t high = table[index + 1];
+        return low + (((high - low) * frac) >> FRAC_BITS);
+    }
+}
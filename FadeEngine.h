@@ -0,0 +1,91 @@
+// FadeEngine.h
+#pragma once
+#include "LightingConfig.h"
+
+// Motor de fundidos no bloqueante.
+// Lleva varios fundidos a la vez (uno por ranura) y los hace avanzar
+// un paso en cada tick, sin detener el loop principal.
+class FadeEngine {
+public:
+    static const uint8_t MAX_FADES = NUM_RGB + NUM_AUX;  // Una ranura por tira y por auxiliar
+    static const uint8_t MAX_COMPONENTS = 3;  // R, G, B
+
+private:
+    struct Fade {
+        uint8_t from[MAX_COMPONENTS];
+        uint8_t to[MAX_COMPONENTS];
+        uint8_t components;
+        unsigned long startTime;
+        unsigned long duration;
+        bool active;
+    };
+
+    Fade fades[MAX_FADES];
+
+public:
+    FadeEngine() {
+        cancelAll();
+    }
+
+    // Inicia (o redirige) el fundido de una ranura desde los valores actuales
+    void start(uint8_t slot, const uint8_t* from, const uint8_t* to,
+               uint8_t components, unsigned long duration, unsigned long now) {
+        if (slot >= MAX_FADES || components > MAX_COMPONENTS) return;
+
+        Fade& fade = fades[slot];
+        for (uint8_t i = 0; i < components; i++) {
+            fade.from[i] = from[i];
+            fade.to[i] = to[i];
+        }
+        fade.components = components;
+        fade.startTime = now;
+        fade.duration = duration;
+        fade.active = true;
+    }
+
+    void cancel(uint8_t slot) {
+        if (slot >= MAX_FADES) return;
+        fades[slot].active = false;
+    }
+
+    void cancelAll() {
+        for (uint8_t i = 0; i < MAX_FADES; i++) {
+            fades[i].active = false;
+        }
+    }
+
+    bool isActive(uint8_t slot) const {
+        return slot < MAX_FADES && fades[slot].active;
+    }
+
+    bool isAnyActive() const {
+        for (uint8_t i = 0; i < MAX_FADES; i++) {
+            if (fades[i].active) return true;
+        }
+        return false;
+    }
+
+    // Calcula los valores actuales de una ranura activa en 'out'.
+    // Devuelve false si la ranura no está activa. Al llegar al final
+    // escribe el destino exacto y la ranura queda libre.
+    bool step(uint8_t slot, unsigned long now, uint8_t* out) {
+        if (!isActive(slot)) return false;
+
+        Fade& fade = fades[slot];
+        unsigned long elapsed = now - fade.startTime;
+
+        if (elapsed >= fade.duration) {
+            for (uint8_t i = 0; i < fade.components; i++) {
+                out[i] = fade.to[i];
+            }
+            fade.active = false;
+            return true;
+        }
+
+        for (uint8_t i = 0; i < fade.components; i++) {
+            int32_t delta = (int32_t)fade.to[i] - fade.from[i];
+            out[i] = fade.from[i] + (int32_t)((int64_t)delta * elapsed / fade.duration);
+        }
+        return true;
+    }
+};
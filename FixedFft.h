@@ -0,0 +1,113 @@
+// FixedFft.h
+#pragma once
+
+// FFT real de 256 puntos en punto fijo (Q15), radix-2 y en el propio
+// buffer. Las tablas de giro (twiddles), la ventana de Hann y la
+// permutación bit-reverse se generan en tiempo de compilación y quedan en
+// flash. Cada etapa divide entre 2 para no desbordar, así que el
+// resultado sale escalado por 1/N.
+static const uint16_t FFT_SIZE = 256;
+static const uint8_t FFT_LOG2_SIZE = 8;
+
+struct FftTables {
+    int16_t cosine[FFT_SIZE / 2];   // cos(2*pi*k/N) en Q15
+    int16_t sine[FFT_SIZE / 2];     // sin(2*pi*k/N) en Q15
+    int16_t window[FFT_SIZE];       // Hann en Q15
+    uint8_t bitReverse[FFT_SIZE];
+};
+
+// Seno para generar tablas: reducción a [-pi, pi] y serie de Taylor
+constexpr double fftSin(double x) {
+    const double PI = 3.14159265358979323846;
+    while (x > PI) x -= 2 * PI;
+    while (x < -PI) x += 2 * PI;
+    double term = x;
+    double sum = x;
+    for (int i = 1; i < 12; i++) {
+        term *= -x * x / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr int16_t toQ15(double value) {
+    double scaled = value * 32767.0;
+    return (int16_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+constexpr FftTables buildFftTables() {
+    const double PI = 3.14159265358979323846;
+    FftTables tables = {};
+    for (int k = 0; k < FFT_SIZE / 2; k++) {
+        double angle = 2 * PI * k / FFT_SIZE;
+        tables.cosine[k] = toQ15(fftSin(angle + PI / 2));
+        tables.sine[k] = toQ15(fftSin(angle));
+    }
+    for (int i = 0; i < FFT_SIZE; i++) {
+        double c = fftSin(2 * PI * i / (FFT_SIZE - 1) + PI / 2);
+        tables.window[i] = toQ15(0.5 - 0.5 * c);
+
+        int reversed = 0;
+        for (int b = 0; b < FFT_LOG2_SIZE; b++) {
+            if (i & (1 << b)) reversed |= 1 << (FFT_LOG2_SIZE - 1 - b);
+        }
+        tables.bitReverse[i] = (uint8_t)reversed;
+    }
+    return tables;
+}
+
+class FixedFft {
+public:
+    static const uint16_t SIZE = FFT_SIZE;
+    static const uint16_t BINS = SIZE / 2;
+
+private:
+    static constexpr FftTables TABLES = buildFftTables();
+
+    static_assert(TABLES.cosine[0] == 32767 && TABLES.sine[0] == 0, "Tabla de giro incorrecta");
+    static_assert(TABLES.window[0] == 0, "La ventana debe empezar en 0");
+
+    int16_t re[SIZE];
+    int16_t im[SIZE];
+
+public:
+    // Copia las muestras aplicando la ventana, en orden bit-reverse
+    void load(const int16_t* samples) {
+        for (uint16_t i = 0; i < SIZE; i++) {
+            uint8_t j = TABLES.bitReverse[i];
+            re[j] = (int16_t)(((int32_t)samples[i] * TABLES.window[i]) >> 15);
+            im[j] = 0;
+        }
+    }
+
+    void transform() {
+        for (uint16_t size = 2, step = SIZE / 2; size <= SIZE; size <<= 1, step >>= 1) {
+            uint16_t half = size >> 1;
+            for (uint16_t start = 0; start < SIZE; start += size) {
+                for (uint16_t k = 0; k < half; k++) {
+                    int32_t wr = TABLES.cosine[k * step];
+                    int32_t wi = -TABLES.sine[k * step];
+                    uint16_t a = start + k;
+                    uint16_t b = a + half;
+
+                    int32_t tr = (wr * re[b] - wi * im[b]) >> 15;
+                    int32_t ti = (wr * im[b] + wi * re[b]) >> 15;
+                    int32_t ar = re[a];
+                    int32_t ai = im[a];
+
+                    re[b] = (int16_t)((ar - tr) >> 1);
+                    im[b] = (int16_t)((ai - ti) >> 1);
+                    re[a] = (int16_t)((ar + tr) >> 1);
+                    im[a] = (int16_t)((ai + ti) >> 1);
+                }
+            }
+        }
+    }
+
+    // Módulo aproximado del bin (max + 3/8 min, error < 7%)
+    uint16_t magnitude(uint16_t bin) const {
+        uint16_t x = re[bin] < 0 ? -re[bin] : re[bin];
+        uint16_t y = im[bin] < 0 ? -im[bin] : im[bin];
+        return x > y ? x + ((3 * y) >> 3) : y + ((3 * x) >> 3);
+    }
+};
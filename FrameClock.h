@@ -0,0 +1,154 @@
+// FrameClock.h
+#pragma once
+#include <atomic>
+
+// Reloj de frames de iluminación por temporizador hardware. La interrupción
+// solo anota el instante del tick y despierta a la tarea de iluminación
+// con una notificación; el plazo (deadline) de cada frame es el siguiente
+// tick, y el frame cumple si la salida PWM está enviada antes.
+//
+// Si la tarea se retrasa y se acumulan ticks, no se recuperan frames uno a
+// uno (la salida depende del tiempo, no del número de frames): se calcula
+// un único frame y los ticks sobrantes se cuentan como saltados.
+//
+// Cuando la salida no va a cambiar, la tarea puede dormir con el
+// temporizador parado (enterIdle/sleep/exitIdle); wake() la despierta
+// antes de tiempo desde otra tarea.
+class FrameClock {
+public:
+    static const uint16_t MIN_RATE_HZ = 100;
+    static const uint16_t MAX_RATE_HZ = 250;
+    static const uint16_t DEFAULT_RATE_HZ = 200;
+
+    struct Tick {
+        uint32_t startUs;     // Instante del tick
+        uint32_t deadlineUs;  // Siguiente tick: la salida debe estar enviada
+    };
+
+    struct Stats {
+        uint32_t frames;           // Frames calculados
+        uint32_t missedDeadlines;  // Frames con la salida enviada tarde
+        uint32_t skippedTicks;     // Ticks descartados al ponerse al día
+        uint32_t catchUps;         // Veces que había más de un tick pendiente
+        uint32_t worstLatenessUs;  // Mayor retraso sobre el plazo
+    };
+
+private:
+    static const uint8_t TIMER_NUMBER = 0;
+    static const uint16_t TIMER_DIVIDER = 80;  // 80 MHz / 80 = 1 us por cuenta
+
+    static inline FrameClock* instance = nullptr;  // Para la rutina de interrupción
+
+    hw_timer_t* timer = nullptr;
+    TaskHandle_t task = nullptr;
+    volatile uint32_t lastTickUs = 0;
+    uint16_t rateHz = DEFAULT_RATE_HZ;
+    uint32_t periodUs = 1000000 / DEFAULT_RATE_HZ;
+    Stats stats = {};
+    std::atomic<bool> resetPending{false};
+    std::atomic<bool> idling{false};
+
+public:
+    static void IRAM_ATTR onTimer() {
+        FrameClock* clock = instance;
+        clock->lastTickUs = micros();
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(clock->task, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+
+    // Desde la tarea que va a esperar los ticks
+    void begin(uint16_t rate) {
+        instance = this;
+        task = xTaskGetCurrentTaskHandle();
+        timer = timerBegin(TIMER_NUMBER, TIMER_DIVIDER, true);
+        timerAttachInterrupt(timer, &FrameClock::onTimer, true);
+        setRate(rate);
+        timerAlarmEnable(timer);
+    }
+
+    // Cambia la frecuencia en marcha; fuera de rango se ajusta al límite
+    void setRate(uint16_t rate) {
+        if (rate < MIN_RATE_HZ) rate = MIN_RATE_HZ;
+        if (rate > MAX_RATE_HZ) rate = MAX_RATE_HZ;
+        rateHz = rate;
+        periodUs = 1000000 / rate;
+        if (timer != nullptr) {
+            timerAlarmWrite(timer, periodUs, true);
+        }
+    }
+
+    uint16_t getRate() const {
+        return rateHz;
+    }
+
+    uint32_t getPeriodUs() const {
+        return periodUs;
+    }
+
+    // Espera al siguiente tick
+    Tick wait() {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending > 1) {
+            stats.catchUps++;
+            stats.skippedTicks += pending - 1;
+        }
+        Tick tick = {lastTickUs, 0};
+        tick.deadlineUs = tick.startUs + periodUs;
+        return tick;
+    }
+
+    // Tras enviar la salida del frame
+    void complete(const Tick& tick) {
+        if (resetPending.exchange(false, std::memory_order_acquire)) {
+            stats = {};
+        }
+        stats.frames++;
+        int32_t lateness = (int32_t)(micros() - tick.deadlineUs);
+        if (lateness > 0) {
+            stats.missedDeadlines++;
+            if ((uint32_t)lateness > stats.worstLatenessUs) {
+                stats.worstLatenessUs = lateness;
+            }
+        }
+    }
+
+    // Reposo: se anuncia antes de comprobar por última vez si hay trabajo,
+    // para que un wake() posterior no se pierda
+    void enterIdle() {
+        idling.store(true);
+        timerAlarmDisable(timer);
+    }
+
+    // Duerme hasta maxMs o hasta wake(); devuelve los ms dormidos
+    uint32_t sleep(uint32_t maxMs) {
+        unsigned long start = millis();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(maxMs));
+        return millis() - start;
+    }
+
+    // Descarta avisos que llegaron tarde (un tick ya pasado o un wake()
+    // sin efecto) y vuelve a arrancar el temporizador desde cero
+    void exitIdle() {
+        idling.store(false);
+        ulTaskNotifyTake(pdTRUE, 0);
+        timerWrite(timer, 0);
+        timerAlarmEnable(timer);
+    }
+
+    // Desde otra tarea, tras dejarle trabajo
+    void wake() {
+        if (idling.load()) xTaskNotifyGive(task);
+    }
+
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    // Desde otra tarea: se aplica en el próximo frame
+    void requestReset() {
+        resetPending.store(true, std::memory_order_release);
+    }
+};
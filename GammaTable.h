@@ -0,0 +1,74 @@
+// GammaTable.h
+#pragma once
+
+// Tabla de corrección perceptual de 8 bits a 12 bits (0-4095 del PCA9685).
+// Se genera en tiempo de compilación con la curva de luminosidad CIE 1931,
+// que solo necesita un cubo, y queda en flash como dato constante.
+
+struct GammaLut {
+    uint16_t value[257];  // La entrada 256 repite la 255 para poder interpolar
+};
+
+constexpr uint16_t cieLevel12Bits(int index) {
+    double lightness = index * 100.0 / 255.0;
+    double luminance = 0.0;
+    if (lightness <= 8.0) {
+        luminance = lightness / 903.3;
+    } else {
+        double t = (lightness + 16.0) / 116.0;
+        luminance = t * t * t;
+    }
+    return (uint16_t)(luminance * 4095 + 0.5);
+}
+
+constexpr GammaLut buildGammaLut() {
+    GammaLut lut = {};
+    for (int i = 0; i < 257; i++) {
+        lut.value[i] = cieLevel12Bits(i < 255 ? i : 255);
+    }
+    return lut;
+}
+
+// Los valores intermedios se expresan como "niveles" de 16 bits en
+// formato 8.8 (valor << 8 | fracción); levelTo12Bits() interpola entre
+// dos entradas de la tabla y así se usan los 4096 pasos del PCA9685.
+class GammaTable {
+private:
+    static constexpr GammaLut LUT = buildGammaLut();
+
+    static_assert(LUT.value[0] == 0, "El nivel 0 debe apagar el canal");
+    static_assert(LUT.value[255] == 4095, "El nivel 255 debe usar los 12 bits");
+
+public:
+    // Valor de 8 bits a 12 bits corregidos
+    static uint16_t to12Bits(uint8_t value) {
+        return LUT.value[value];
+    }
+
+    // Nivel 8.8 a 12 bits corregidos, interpolando entre entradas
+    static uint16_t levelTo12Bits(uint16_t level) {
+        uint8_t index = level >> 8;
+        uint8_t frac = level & 0xFF;
+        uint16_t low = LUT.value[index];
+        uint16_t high = LUT.value[index + 1];
+        return low + (((high - low) * frac) >> 8);
+    }
+
+    // Interpolación en punto fijo: progreso Q16 (0-65536) a nivel 8.8
+    static uint16_t interpolateLevel(uint8_t start, uint8_t end, uint32_t progressQ16) {
+        int32_t delta = (int32_t)end - start;
+        return (uint16_t)(((int32_t)start << 8) + ((delta * (int32_t)progressQ16) >> 8));
+    }
+
+    // Igual, entre dos niveles 8.8 (re-base de un fundido en curso)
+    static uint16_t blendLevels(uint16_t start, uint16_t end, uint32_t progressQ16) {
+        int32_t delta = (int32_t)end - start;
+        return (uint16_t)(start + (((int64_t)delta * progressQ16) >> 16));
+    }
+
+    // Nivel 8.8 redondeado a 8 bits, para SystemState y la pantalla
+    static uint8_t levelTo8Bits(uint16_t level) {
+        uint16_t rounded = (level >> 8) + ((level & 0x80) ? 1 : 0);
+        return rounded > 255 ? 255 : rounded;
+    }
+};
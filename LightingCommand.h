@@ -0,0 +1,52 @@
+// LightingCommand.h
+#pragma once
+#include "Timeline.h"
+
+struct PhaseConfig;
+
+// Orden enviada desde la tarea de comunicaciones (Bluetooth/UI) a la tarea
+// de iluminación a través de una SpscQueue. Es un tipo plano para poder
+// copiarse en la cola sin reservar memoria.
+//
+// Las órdenes de fases y línea de tiempo van a la zona elegida con la
+// última SELECT_ZONE (todas por defecto); SET_CLOCK va siempre a todas.
+struct LightingCommand {
+    enum Type : uint8_t {
+        APPLY_PHASE,        // phase
+        START_TRANSITION,   // phase -> targetPhase en duration ms
+        CONFIGURE_PHASE,    // phase, rgb, auxiliary, duration, crossFade, easing
+        START_SEQUENCE,
+        STOP_SEQUENCE,
+        REQUEST_SAVE,       // Guardado diferido de la configuración
+        TIMELINE_BEGIN,     // Nueva línea de tiempo de duration ms
+        TIMELINE_KEYFRAME,  // keyframe
+        TIMELINE_COMMIT,    // Sustituye la línea de tiempo activa
+        TIMELINE_FROM_PHASES,
+        SET_CLOCK,          // duration = ms desde medianoche
+        SET_CLOCK_MODE,     // phase = 1 anclada a la hora del día, 0 desde PLAY
+        SET_AUDIO_MODE,     // phase = AUDIO_MODE_*
+        SET_FRAME_RATE,     // duration = Hz
+        SET_PHASE_FIELD,    // phase, field = PHASE_FIELD_* o nivel, value
+        SELECT_ZONE,        // phase = índice de zona o ZONE_ALL; destino de las siguientes
+        USE_PROFILE         // profile (tabla de ProfileLibrary), phase = perfil, duration = fundido ms
+    };
+
+    Type type;
+    uint8_t phase;
+    uint8_t targetPhase;
+    uint8_t rgb[NUM_RGB][3];
+    uint8_t auxiliary[NUM_AUX];
+    uint32_t duration;
+    uint32_t crossFade;
+    uint8_t easing;             // Easing::Curve
+    uint8_t field;
+    uint32_t value;
+    Timeline::Keyframe keyframe;
+    const PhaseConfig* profile;  // NUM_PHASES fases; las guarda ProfileLibrary
+
+    static LightingCommand make(Type type) {
+        LightingCommand command = {};
+        command.type = type;
+        return command;
+    }
+};
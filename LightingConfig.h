@@ -0,0 +1,50 @@
+// LightingConfig.h
+#pragma once
+
+// Dimensiones de la instalación. SystemState, RGBController y
+// PhaseController se dimensionan con estos valores (los bucles de salida
+// e interpolación tienen trip count fijo y el compilador los desenrolla);
+// los formatos que se guardan o viajan por Bluetooth (Timeline::Keyframe,
+// LightingCommand, registros binarios, campos ASCII) se dimensionan con
+// ellos y comprueban su tamaño con static_assert.
+static const uint8_t NUM_RGB = 2;       // Tiras RGB
+static const uint8_t NUM_AUX = 5;       // Canales auxiliares
+static const uint8_t NUM_PHASES = 5;    // Apagado, Alba, Día, Tarde, Noche
+
+// Canales PWM lógicos: R, G, B de cada tira y después los auxiliares
+static const uint8_t NUM_LOGICAL_CHANNELS = NUM_RGB * 3 + NUM_AUX;
+
+// Campos de una fase para los cambios sueltos (AJUSTE_FASE): los primeros
+// NUM_LOGICAL_CHANNELS son los niveles, en el orden de los canales lógicos
+static const uint8_t PHASE_FIELD_DURATION = NUM_LOGICAL_CHANNELS;
+static const uint8_t PHASE_FIELD_CROSSFADE = NUM_LOGICAL_CHANNELS + 1;
+static const uint8_t PHASE_FIELD_EASING = NUM_LOGICAL_CHANNELS + 2;
+static const uint8_t PHASE_FIELD_COUNT = NUM_LOGICAL_CHANNELS + 3;
+
+// Zonas: cada una es un PhaseController con su propia línea de tiempo y
+// sus tiempos, que solo escribe los canales y relés de su máscara (bit i =
+// tira RGB i, auxiliar i o relé i). Entre todas cubren cada canal una vez.
+struct ZoneLayout {
+    uint8_t rgbMask;
+    uint8_t auxMask;
+    uint8_t relayMask;
+};
+
+static const uint8_t NUM_ZONES = 2;
+static const uint8_t ZONE_ALL = 0xFF;   // Órdenes para todas las zonas
+
+static constexpr ZoneLayout ZONE_LAYOUTS[NUM_ZONES] = {
+    {0x01, 0x03, 0x03},     // Zona 1: RGB1, auxiliares 1-2 y los dos relés
+    {0x02, 0x1C, 0x00},     // Zona 2: RGB2, auxiliares 3-5
+};
+
+constexpr bool zonesCoverEachChannelOnce() {
+    uint8_t rgb = 0, aux = 0;
+    for (uint8_t z = 0; z < NUM_ZONES; z++) {
+        if ((rgb & ZONE_LAYOUTS[z].rgbMask) || (aux & ZONE_LAYOUTS[z].auxMask)) return false;
+        rgb |= ZONE_LAYOUTS[z].rgbMask;
+        aux |= ZONE_LAYOUTS[z].auxMask;
+    }
+    return rgb == (1 << NUM_RGB) - 1 && aux == (1 << NUM_AUX) - 1;
+}
+static_assert(zonesCoverEachChannelOnce(), "ZONE_LAYOUTS debe repartir cada canal a una sola zona");
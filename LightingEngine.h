@@ -0,0 +1,316 @@
+// LightingEngine.h
+#pragma once
+#include "SystemState.h"
+#include "RGBController.h"
+#include "PhaseController.h"
+#include "LightingCommand.h"
+#include "SpscQueue.h"
+#include "SeqLock.h"
+#include "LoopStats.h"
+#include "AudioReactive.h"
+#include "FrameClock.h"
+#include "ConfigStore.h"
+#include "Scheduler.h"
+#include "OutputSnapshot.h"
+#include "Log.h"
+
+// Motor de iluminación: un PhaseController por zona + RGBController en su propia tarea
+// FreeRTOS anclada a un núcleo, a ritmo fijo marcado por FrameClock
+// (temporizador hardware). La frecuencia se cambia en marcha y se guarda.
+//
+// Solo esta tarea modifica el estado de iluminación. El resto del sistema
+// le manda órdenes por una cola SPSC (post) y lee una instantánea de
+// SystemState publicada al final de cada frame (readSnapshot). Lo que no
+// ocurre en cada frame (keyframes, fin de transición, guardados) va en su
+// Scheduler y se despacha al principio del frame. Cada zona escribe sus
+// canales y el frame termina con un único volcado PWM para todas.
+//
+// Sin fundidos en curso la tarea duerme con el reloj de frames parado
+// hasta el próximo evento o keyframe; una orden nueva la despierta. Antes
+// de dormir avisa a OutputSnapshot, que guarda la salida ya asentada.
+class LightingEngine {
+private:
+    // Ajustes propios del motor, en /engine.cfg
+    struct Settings {
+        uint16_t frameRate;
+        uint16_t reserved;
+    };
+    static const uint32_t SETTINGS_MAGIC = 0x314E4745;  // "EGN1"
+    static const uint16_t SETTINGS_VERSION = 1;
+    static const uint32_t MIN_IDLE_MS = 20;  // Menos no compensa parar el reloj
+
+    SystemState& state;
+    PhaseController (&zones)[NUM_ZONES];
+    RGBController& rgbController;
+    OutputSnapshot& outputSnapshot;
+    AudioReactive& audioReactive;
+    FrameClock& frameClock;
+    LoopStats& stats;
+    Scheduler& scheduler;
+    Scheduler::Handle settingsSaveEvent;
+    Settings settings = {FrameClock::DEFAULT_RATE_HZ, 0};
+    ConfigStore settingsStore{"/engine.cfg", "/engine.tmp", SETTINGS_MAGIC, SETTINGS_VERSION};
+    uint32_t lastI2CTransactions = 0;
+    std::atomic<uint32_t> profileSwitches{0};  // Órdenes USE_PROFILE ya ejecutadas
+
+    SpscQueue<LightingCommand, 32> commands;  // Holgura para cargas de keyframes
+    SeqLock<SystemState> snapshot;
+    TaskHandle_t taskHandle = nullptr;
+
+    void execute(const LightingCommand& command) {
+        switch (command.type) {
+            case LightingCommand::SET_CLOCK:
+                for (PhaseController& zone : zones) {
+                    zone.setClock(command.duration);
+                }
+                break;
+            case LightingCommand::SET_AUDIO_MODE:
+                setAudioMode(command.phase);
+                break;
+            case LightingCommand::SET_FRAME_RATE:
+                frameClock.setRate((uint16_t)command.duration);
+                settings.frameRate = frameClock.getRate();
+                requestSettingsSave();
+                LOG_INFO("Frecuencia de frames: %u Hz", settings.frameRate);
+                break;
+            case LightingCommand::SELECT_ZONE:
+                state.selectedZone = command.phase < NUM_ZONES ? command.phase : ZONE_ALL;
+                break;
+            case LightingCommand::USE_PROFILE:
+                forSelectedZones(command);
+                // Desde aquí ninguna zona puede pasar a usar una tabla de
+                // perfil que no sea la de esta orden (ProfileLibrary)
+                profileSwitches.fetch_add(1, std::memory_order_release);
+                break;
+            default:
+                forSelectedZones(command);
+                break;
+        }
+    }
+
+    void forSelectedZones(const LightingCommand& command) {
+        for (uint8_t i = 0; i < NUM_ZONES; i++) {
+            if (state.selectedZone == ZONE_ALL || state.selectedZone == i) {
+                executeOnZone(zones[i], command);
+            }
+        }
+    }
+
+    void executeOnZone(PhaseController& phaseController, const LightingCommand& command) {
+        switch (command.type) {
+            case LightingCommand::APPLY_PHASE:
+                phaseController.applyPhase(command.phase);
+                break;
+            case LightingCommand::START_TRANSITION:
+                phaseController.startTransition(command.phase, command.targetPhase, command.duration);
+                break;
+            case LightingCommand::CONFIGURE_PHASE:
+                phaseController.configurePhase(
+                    command.phase,
+                    command.rgb,
+                    command.auxiliary,
+                    command.duration,
+                    command.crossFade,
+                    command.easing);
+                break;
+            case LightingCommand::START_SEQUENCE:
+                phaseController.startSequence();
+                break;
+            case LightingCommand::STOP_SEQUENCE:
+                phaseController.stopSequence();
+                break;
+            case LightingCommand::REQUEST_SAVE:
+                phaseController.requestSave();
+                break;
+            case LightingCommand::TIMELINE_BEGIN:
+                phaseController.beginTimeline(command.duration);
+                break;
+            case LightingCommand::TIMELINE_KEYFRAME:
+                phaseController.addKeyframe(command.keyframe);
+                break;
+            case LightingCommand::TIMELINE_COMMIT:
+                phaseController.commitTimeline();
+                break;
+            case LightingCommand::TIMELINE_FROM_PHASES:
+                phaseController.useTimelineFromPhases();
+                break;
+            case LightingCommand::SET_CLOCK_MODE:
+                phaseController.setClockMode(command.phase != 0);
+                break;
+            case LightingCommand::SET_PHASE_FIELD:
+                phaseController.setPhaseField(command.phase, command.field, command.value);
+                break;
+            case LightingCommand::USE_PROFILE:
+                phaseController.useProfile(command.profile, command.phase, command.duration);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void setAudioMode(uint8_t mode) {
+        if (mode == state.audioMode) return;
+        state.audioMode = mode;
+        bool reactive = mode == AUDIO_MODE_REACTIVE;
+        if (reactive) audioReactive.reset();
+        for (PhaseController& zone : zones) {
+            zone.setOutputSuspended(reactive);
+        }
+    }
+
+    void requestSettingsSave() {
+        unsigned long now = millis();
+        settingsStore.requestSave(now);
+        scheduler.schedule(settingsSaveEvent, now + ConfigStore::QUIET_PERIOD_MS);
+    }
+
+    static void settingsSaveCallback(void* self) {
+        LightingEngine* engine = static_cast<LightingEngine*>(self);
+        if (engine->settingsStore.isSaveDue(millis())) {
+            engine->settingsStore.save((const uint8_t*)&engine->settings, sizeof(engine->settings));
+        }
+    }
+
+    // ms que se puede dormir ahora sin cambiar la salida
+    uint32_t idleTime() {
+        if (state.audioMode == AUDIO_MODE_REACTIVE || rgbController.isFading() || !commands.isEmpty()) {
+            return 0;
+        }
+        unsigned long now = millis();
+        uint32_t idle = scheduler.nextDue(now);
+        for (PhaseController& zone : zones) {
+            uint32_t quiet = zone.quietTime(now);
+            if (quiet < idle) idle = quiet;
+        }
+        return idle;
+    }
+
+    static void taskEntry(void* param) {
+        LightingEngine* engine = static_cast<LightingEngine*>(param);
+        engine->startFrameClock();
+        for (;;) {
+            engine->runTick();
+        }
+    }
+
+public:
+    static const uint8_t SCHEDULER_EVENTS = 1;
+
+    LightingEngine(SystemState& systemState, PhaseController (&phaseZones)[NUM_ZONES], RGBController& rgb,
+                   OutputSnapshot& snapshotStore, AudioReactive& reactive, FrameClock& clock, LoopStats& loopStats,
+                   Scheduler& taskScheduler)
+        : state(systemState), zones(phaseZones), rgbController(rgb), outputSnapshot(snapshotStore),
+          audioReactive(reactive), frameClock(clock), stats(loopStats), scheduler(taskScheduler) {
+        settingsSaveEvent = scheduler.add(settingsSaveCallback, this);
+        if (settingsSaveEvent == Scheduler::INVALID_HANDLE) {
+            LOG_ERROR("Motor: planificador lleno, los ajustes no se guardaran");
+        }
+    }
+
+    // Carga los ajustes y publica el estado inicial; llamar antes de leer
+    // instantáneas
+    void begin() {
+        if (settingsStore.load((uint8_t*)&settings, sizeof(settings)) != ConfigStore::LOAD_OK) {
+            settings.frameRate = FrameClock::DEFAULT_RATE_HZ;
+        }
+        frameClock.setRate(settings.frameRate);
+        snapshot.write(state);
+    }
+
+    // Desde la tarea que procesa los frames (recibe las notificaciones)
+    void startFrameClock() {
+        frameClock.begin(settings.frameRate);
+    }
+
+    // Espera el tick, calcula el frame y comprueba el plazo; después
+    // duerme si no hay nada que animar
+    void runTick() {
+        FrameClock::Tick tick = frameClock.wait();
+        runFrame();
+        frameClock.complete(tick);
+
+        uint32_t idle = idleTime();
+        if (idle < MIN_IDLE_MS) return;
+        outputSnapshot.settled(millis());
+        frameClock.enterIdle();
+        if (commands.isEmpty()) {  // Una orden anterior a enterIdle() no despierta
+            stats.slept(LoopStats::LIGHTING_TASK, frameClock.sleep(idle));
+        }
+        frameClock.exitIdle();
+    }
+
+    // Crea la tarea de iluminación anclada al núcleo indicado
+    void startTask(BaseType_t core, UBaseType_t priority = 3) {
+        xTaskCreatePinnedToCore(taskEntry, "lighting", 4096, this, priority, &taskHandle, core);
+    }
+
+    // Un frame: órdenes pendientes, eventos vencidos, fases de cada zona,
+    // fundidos, salida I2C (un volcado para todas las zonas) y publicación
+    void runFrame() {
+        LoopStats::Scope frameTimer(stats, LoopStats::LIGHTING_FRAME);
+
+        LightingCommand command;
+        while (commands.pop(command)) {
+            execute(command);
+        }
+        scheduler.runDue(millis());
+
+        {
+            LoopStats::Scope timer(stats, LoopStats::PHASES);
+            for (PhaseController& zone : zones) {
+                zone.update();
+            }
+        }
+        // Solo se cuentan los frames con análisis (uno de cada cuatro)
+        if (state.audioMode == AUDIO_MODE_REACTIVE) {
+            uint32_t start = LoopStats::cycles();
+            if (audioReactive.update()) {
+                stats.record(LoopStats::AUDIO_ANALYSIS, LoopStats::cycles() - start);
+            }
+        }
+        {
+            LoopStats::Scope timer(stats, LoopStats::PWM_OUTPUT);
+            rgbController.update();
+        }
+
+        uint32_t transactions = rgbController.getOutputStats().transactions;
+        stats.count(LoopStats::I2C_WRITES, transactions - lastI2CTransactions);
+        lastI2CTransactions = transactions;
+
+        snapshot.write(state);
+    }
+
+    // Productor único: la tarea de comunicaciones
+    bool post(const LightingCommand& command) {
+        if (!commands.push(command)) return false;
+        frameClock.wake();
+        return true;
+    }
+
+    // Para órdenes que deben entrar juntas (p. ej. una carga por lotes)
+    bool canPost(uint32_t count) const {
+        return commands.freeSpace() >= count;
+    }
+
+    void readSnapshot(SystemState& out) const {
+        snapshot.read(out);
+    }
+
+    // Lectura desde otra tarea; son contadores de 32 bits sueltos
+    const FrameClock::Stats& getFrameClockStats() const {
+        return frameClock.getStats();
+    }
+
+    uint16_t getFrameRate() const {
+        return frameClock.getRate();
+    }
+
+    // Desde la tarea de comunicaciones
+    uint32_t getProfileSwitches() const {
+        return profileSwitches.load(std::memory_order_acquire);
+    }
+
+    void requestFrameClockReset() {
+        frameClock.requestReset();
+    }
+};
@@ -0,0 +1,256 @@
+// Log.h
+#pragma once
+#include <atomic>
+#include <type_traits>
+
+// Registro asíncrono. LOG_*() no formatea ni toca la UART: copia el puntero
+// al formato y los argumentos en un buffer circular sin bloqueos y vuelve.
+// El texto se forma después en drain(), desde la tarea de comunicaciones,
+// que solo escribe lo que cabe en la FIFO de la UART. Con el buffer lleno
+// el registro se descarta y se cuenta; nunca se espera.
+//
+// Nivel de compilación: LOG_LEVEL (p. ej. -DLOG_LEVEL=LOG_LEVEL_INFO); los
+// LOG_*() por encima no generan código. Nivel en marcha: setLevel(),
+// comando LOG por Bluetooth.
+//
+// Los formatos deben ser literales y los argumentos, enteros que quepan en
+// un puntero o cadenas constantes: se guarda el puntero, no el texto, así
+// que nada de buffers locales. No hay %f ni %ll.
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// El printf sin evaluar solo sirve para que el compilador compruebe el formato
+#define LOG_AT(level, ...)                                       \
+    do {                                                         \
+        if ((level) <= LOG_LEVEL) {                              \
+            (void)sizeof(::printf(__VA_ARGS__));                 \
+            Log::instance().write((Log::Level)(level), __VA_ARGS__); \
+        }                                                        \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+class Log {
+public:
+    enum Level : uint8_t {
+        LEVEL_ERROR = LOG_LEVEL_ERROR,
+        LEVEL_WARN = LOG_LEVEL_WARN,
+        LEVEL_INFO = LOG_LEVEL_INFO,
+        LEVEL_DEBUG = LOG_LEVEL_DEBUG
+    };
+
+    typedef uintptr_t Arg;
+
+    static const uint8_t MAX_ARGS = 6;
+    static const uint32_t CAPACITY = 64;      // Registros; potencia de 2
+    static const uint8_t LINE_SIZE = 120;     // Cabe en la FIFO de la UART (128)
+    static const uint32_t DRAIN_RETRY_MS = 10;  // ~115 bytes a 115200 baudios
+
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "La capacidad debe ser potencia de 2");
+
+    struct Record {
+        const char* format;
+        uint32_t time;
+        uint8_t level;
+        uint8_t argCount;
+        Arg args[MAX_ARGS];
+    };
+
+    // Cola acotada de varios productores (las dos tareas y setup()) y un
+    // consumidor. Cada hueco lleva su número de secuencia: un productor
+    // reserva con CAS sobre 'head', rellena y publica el hueco; el
+    // consumidor solo lee huecos ya publicados.
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        Record record;
+    };
+
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> head{0};
+    uint32_t tail = 0;                  // Solo el consumidor
+    std::atomic<uint8_t> level{LEVEL_INFO};
+    std::atomic<uint32_t> dropped{0};
+    uint32_t reportedDropped = 0;       // Solo el consumidor
+    uint32_t written = 0;               // Solo el consumidor
+
+    Log() {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T>
+    static Arg toArg(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                      "LOG: solo enteros y cadenas constantes");
+        static_assert(sizeof(T) <= sizeof(Arg), "LOG: argumento demasiado grande");
+        if constexpr (std::is_pointer<T>::value) {
+            return (Arg)value;
+        } else {
+            return (Arg)(intptr_t)value;
+        }
+    }
+
+    void push(Level messageLevel, const char* format, const Arg* args, uint8_t argCount) {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[position & (CAPACITY - 1)];
+            int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - position);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);  // Lleno
+                return;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        Record& record = slot->record;
+        record.format = format;
+        record.time = millis();
+        record.level = messageLevel;
+        record.argCount = argCount;
+        for (uint8_t i = 0; i < argCount; i++) {
+            record.args[i] = args[i];
+        }
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    // Formatea una especificación con el argumento ya convertido a su tipo
+    static int formatArg(char* out, size_t size, const char* spec, char conversion, bool isLong, Arg arg) {
+        switch (conversion) {
+            case 's':
+                return snprintf(out, size, spec, arg != 0 ? (const char*)arg : "(null)");
+            case 'c':
+            case 'd':
+            case 'i':
+                return isLong ? snprintf(out, size, spec, (long)(intptr_t)arg)
+                              : snprintf(out, size, spec, (int)(intptr_t)arg);
+            case 'p':
+                return snprintf(out, size, spec, (void*)arg);
+            default:  // u, x, X, o
+                return isLong ? snprintf(out, size, spec, (unsigned long)arg)
+                              : snprintf(out, size, spec, (unsigned)arg);
+        }
+    }
+
+    // Texto de un registro: "[s.mmm] mensaje\n", recortado a 'size'
+    static size_t format(char* out, size_t size, const Record& record) {
+        int length = snprintf(out, size, "[%lu.%03lu] ",
+                              (unsigned long)(record.time / 1000), (unsigned long)(record.time % 1000));
+        size_t end = size - 2;  // Sitio para '\n' y '\0'
+        uint8_t next = 0;
+        const char* p = record.format;
+
+        while (*p != '\0' && (size_t)length < end) {
+            if (*p != '%') {
+                out[length++] = *p++;
+                continue;
+            }
+            // %[opciones][ancho][.precisión][h|l]conversión
+            char spec[12];
+            uint8_t n = 0;
+            spec[n++] = *p++;
+            while (*p != '\0' && strchr("-+ #0123456789.hl", *p) != nullptr && n < sizeof(spec) - 2) {
+                spec[n++] = *p++;
+            }
+            if (*p == '\0') break;
+            char conversion = *p++;
+            if (conversion == '%') {
+                out[length++] = '%';
+                continue;
+            }
+            spec[n++] = conversion;
+            spec[n] = '\0';
+
+            Arg arg = next < record.argCount ? record.args[next++] : 0;
+            int added = formatArg(out + length, end - length + 1, spec, conversion,
+                                  strchr(spec, 'l') != nullptr, arg);
+            if (added < 0) break;
+            length += (size_t)added < end - length ? added : end - length;
+        }
+
+        // Los formatos antiguos terminaban en '\n'; aquí se añade siempre uno
+        if (length > 0 && out[length - 1] == '\n') length--;
+        out[length++] = '\n';
+        out[length] = '\0';
+        return length;
+    }
+
+public:
+    static Log& instance() {
+        static Log log;
+        return log;
+    }
+
+    // Productores (cualquier tarea, no interrupciones); usar las macros LOG_*
+    template <typename... Args>
+    void write(Level messageLevel, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "LOG: demasiados argumentos");
+        if (messageLevel > level.load(std::memory_order_relaxed)) return;
+        const Arg packed[] = {toArg(args)..., 0};
+        push(messageLevel, format, packed, sizeof...(Args));
+    }
+
+    void setLevel(uint8_t newLevel) {
+        level.store(newLevel > LEVEL_DEBUG ? (uint8_t)LEVEL_DEBUG : newLevel, std::memory_order_relaxed);
+    }
+
+    uint8_t getLevel() const {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    // Consumidor: escribe lo que quepa en el puerto sin esperar y devuelve
+    // cuántos registros ha sacado
+    uint16_t drain(Stream& port) {
+        char line[LINE_SIZE];
+        uint16_t count = 0;
+
+        uint32_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != reportedDropped) {
+            int length = snprintf(line, sizeof(line), "[log] %lu registros perdidos\n",
+                                  (unsigned long)(lost - reportedDropped));
+            if (port.availableForWrite() < length) return 0;
+            port.write((const uint8_t*)line, length);
+            reportedDropped = lost;
+        }
+
+        for (;;) {
+            Slot& slot = slots[tail & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1) break;  // Vacío
+            size_t length = format(line, sizeof(line), slot.record);
+            if (port.availableForWrite() < (int)length) break;  // Se sigue en la próxima vuelta
+            port.write((const uint8_t*)line, length);
+            slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+            tail++;
+            written++;
+            count++;
+        }
+        return count;
+    }
+
+    // Consumidor
+    bool isEmpty() const {
+        return slots[tail & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) != tail + 1;
+    }
+
+    uint32_t getWritten() const {
+        return written;
+    }
+
+    uint32_t getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,207 @@
+// LoopStats.h
+#pragma once
+#include <atomic>
+
+// Medidas de latencia por subsistema con el contador de ciclos de la CPU:
+// mínimo, media, máximo e histograma logarítmico, todo en memoria fija.
+//
+// Cada subsistema lo mide siempre la misma tarea (la que lo ejecuta), así
+// que record() no necesita bloqueos. Un reinicio pedido desde otra tarea se
+// aplica en el siguiente record() de la tarea propietaria.
+class LoopStats {
+public:
+    enum Subsystem {
+        BLUETOOTH,       // BluetoothController::update()
+        PHASES,          // PhaseController::update()
+        PWM_OUTPUT,      // RGBController::update() (fundidos + I2C)
+        DISPLAY,         // UIController::updateDisplay()
+        LIGHTING_FRAME,  // Frame completo de la tarea de iluminación
+        AUDIO,           // AudioController::update() (enlace UART con el Nano)
+        AUDIO_ANALYSIS,  // AudioReactive::update() con un bloque (FFT)
+        SUBSYSTEM_COUNT
+    };
+
+    enum Counter {
+        I2C_WRITES,      // Transacciones I2C enviadas
+        TFT_REDRAWS,     // Campos o pantallas redibujados
+        BT_BYTES,        // Bytes recibidos por Bluetooth
+        COUNTER_COUNT
+    };
+
+    // Tareas que duermen cuando no tienen nada que hacer
+    enum Task {
+        LIGHTING_TASK,
+        COMMS_TASK,
+        TASK_COUNT
+    };
+
+    // Hitos del arranque; no se borran con requestReset()
+    enum BootStage {
+        BOOT_FIRST_LIGHT,   // Salida restaurada enviada a las placas
+        BOOT_READY,         // Pantalla y Bluetooth listos
+        BOOT_STAGE_COUNT
+    };
+
+    // Cubo i: duraciones de [2^(i-1), 2^i) ciclos; el último acumula el resto
+    static const uint8_t HISTOGRAM_BUCKETS = 24;
+
+    struct Timing {
+        uint32_t count;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint64_t totalCycles;
+        uint32_t histogram[HISTOGRAM_BUCKETS];
+    };
+
+    // Mide el ámbito en el que se declara
+    class Scope {
+    private:
+        LoopStats& stats;
+        Subsystem subsystem;
+        uint32_t start;
+
+    public:
+        Scope(LoopStats& loopStats, Subsystem measured)
+            : stats(loopStats), subsystem(measured), start(LoopStats::cycles()) {}
+        ~Scope() {
+            stats.record(subsystem, LoopStats::cycles() - start);
+        }
+    };
+
+private:
+    Timing timings[SUBSYSTEM_COUNT];
+    std::atomic<bool> resetPending[SUBSYSTEM_COUNT];
+    std::atomic<uint32_t> counters[COUNTER_COUNT];
+    std::atomic<uint32_t> sleptMs[TASK_COUNT];
+    std::atomic<uint32_t> sleeps[TASK_COUNT];
+    std::atomic<uint32_t> windowStart{0};   // millis() del último reinicio
+    std::atomic<uint32_t> bootMs[BOOT_STAGE_COUNT];
+
+    static void clear(Timing& timing) {
+        memset(&timing, 0, sizeof(timing));
+        timing.minCycles = UINT32_MAX;
+    }
+
+public:
+    LoopStats() {
+        for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+            clear(timings[i]);
+            resetPending[i] = false;
+        }
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            counters[i] = 0;
+        }
+        for (int i = 0; i < TASK_COUNT; i++) {
+            sleptMs[i] = 0;
+            sleeps[i] = 0;
+        }
+        for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+            bootMs[i] = 0;
+        }
+    }
+
+    static uint32_t cycles() {
+        return ESP.getCycleCount();
+    }
+
+    static uint32_t cyclesToMicros(uint32_t cycleCount) {
+        return cycleCount / getCpuFrequencyMhz();
+    }
+
+    static uint32_t cyclesToNanos(uint32_t cycleCount) {
+        return (uint32_t)((uint64_t)cycleCount * 1000 / getCpuFrequencyMhz());
+    }
+
+    static const char* name(Subsystem subsystem) {
+        static const char* const NAMES[SUBSYSTEM_COUNT] = {"BT", "Fases", "Salida", "TFT", "Frame", "Audio", "FFT"};
+        return NAMES[subsystem];
+    }
+
+    // Solo desde la tarea que ejecuta el subsistema
+    void record(Subsystem subsystem, uint32_t cycleCount) {
+        Timing& timing = timings[subsystem];
+        if (resetPending[subsystem].exchange(false, std::memory_order_acquire)) {
+            clear(timing);
+        }
+
+        timing.count++;
+        timing.totalCycles += cycleCount;
+        if (cycleCount < timing.minCycles) timing.minCycles = cycleCount;
+        if (cycleCount > timing.maxCycles) timing.maxCycles = cycleCount;
+
+        uint8_t bucket = cycleCount == 0 ? 0 : 32 - __builtin_clz(cycleCount);
+        if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+        timing.histogram[bucket]++;
+    }
+
+    void count(Counter counter, uint32_t amount = 1) {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint32_t counter(Counter counter) const {
+        return counters[counter].load(std::memory_order_relaxed);
+    }
+
+    static const char* taskName(Task task) {
+        static const char* const NAMES[TASK_COUNT] = {"iluminacion", "comunicaciones"};
+        return NAMES[task];
+    }
+
+    // Solo desde la tarea que ha dormido
+    void slept(Task task, uint32_t ms) {
+        sleptMs[task].fetch_add(ms, std::memory_order_relaxed);
+        sleeps[task].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t sleptTime(Task task) const {
+        return sleptMs[task].load(std::memory_order_relaxed);
+    }
+
+    uint32_t sleepCount(Task task) const {
+        return sleeps[task].load(std::memory_order_relaxed);
+    }
+
+    // ms desde el último reinicio de las medidas
+    uint32_t measuredTime() const {
+        return millis() - windowStart.load(std::memory_order_relaxed);
+    }
+
+    // Tiempo despierta en tanto por mil (1000 = nunca ha dormido)
+    uint16_t dutyCycle(Task task) const {
+        uint32_t total = measuredTime();
+        uint32_t slept = sleptTime(task);
+        if (total == 0 || slept >= total) return total == 0 ? 1000 : 0;
+        return (uint16_t)((uint64_t)(total - slept) * 1000 / total);
+    }
+
+    // Anota un hito del arranque en ms desde el encendido
+    void bootStage(BootStage stage) {
+        bootMs[stage].store(millis(), std::memory_order_relaxed);
+    }
+
+    // 0 si aún no se ha alcanzado
+    uint32_t bootTime(BootStage stage) const {
+        return bootMs[stage].load(std::memory_order_relaxed);
+    }
+
+    // Desde cualquier tarea: las medidas se vacían en su próximo record()
+    void requestReset() {
+        for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+            resetPending[i].store(true, std::memory_order_release);
+        }
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            counters[i].store(0, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < TASK_COUNT; i++) {
+            sleptMs[i].store(0, std::memory_order_relaxed);
+            sleeps[i].store(0, std::memory_order_relaxed);
+        }
+        windowStart.store(millis(), std::memory_order_relaxed);
+    }
+
+    // Lectura de diagnóstico desde otra tarea: puede mezclar valores de dos
+    // medidas consecutivas, pero nunca bloquea a la tarea medida
+    const Timing& timing(Subsystem subsystem) const {
+        return timings[subsystem];
+    }
+};
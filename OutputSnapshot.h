@@ -0,0 +1,96 @@
+// OutputSnapshot.h
+#pragma once
+#include "SystemState.h"
+#include "RGBController.h"
+#include "RelayOutput.h"
+#include "ConfigStore.h"
+#include "Scheduler.h"
+#include "Log.h"
+
+// Última salida asentada (niveles de cada canal lógico y relés) en
+// /output.cfg, para que tras un corte de luz las placas vuelvan a ella en
+// cuanto arranca el bus I2C, antes que la pantalla y el Bluetooth.
+//
+// Solo se guarda con la salida quieta: la tarea de iluminación llama a
+// settled() al irse a dormir y el guardado espera SAVE_DELAY_MS más, así
+// que los fundidos no desgastan la flash.
+class OutputSnapshot {
+private:
+    struct Record {
+        uint8_t levels[NUM_LOGICAL_CHANNELS];   // RGB (3 por tira) y auxiliares
+        uint8_t relays;                         // Bit i = relé i
+        uint8_t reserved;
+    };
+
+    static const uint32_t MAGIC = 0x3154554F;   // "OUT1"
+    static const uint16_t VERSION = 1;
+    static const uint32_t SAVE_DELAY_MS = 10000;
+
+    SystemState& state;
+    RGBController& rgbController;
+    RelayOutput& relays;
+    Scheduler& scheduler;
+    Scheduler::Handle saveEvent;
+    ConfigStore store{"/output.cfg", "/output.tmp", MAGIC, VERSION};
+    Record saved = {};                          // Lo que hay en el fichero
+
+    void capture(Record& record) const {
+        memset(&record, 0, sizeof(record));
+        for (uint8_t i = 0; i < NUM_RGB; i++) {
+            record.levels[i * 3] = state.rgb[i].r;
+            record.levels[i * 3 + 1] = state.rgb[i].g;
+            record.levels[i * 3 + 2] = state.rgb[i].b;
+        }
+        memcpy(record.levels + NUM_RGB * 3, state.auxiliary, NUM_AUX);
+        record.relays = relays.get();
+    }
+
+    void onSaveDue() {
+        Record current;
+        capture(current);
+        if (memcmp(&current, &saved, sizeof(current)) == 0) return;
+        if (!store.save((const uint8_t*)&current, sizeof(current))) {
+            LOG_ERROR("Error guardando la salida");
+            return;
+        }
+        saved = current;
+    }
+
+    static void saveCallback(void* self) {
+        static_cast<OutputSnapshot*>(self)->onSaveDue();
+    }
+
+public:
+    static const uint8_t SCHEDULER_EVENTS = 1;
+
+    OutputSnapshot(SystemState& systemState, RGBController& rgb, RelayOutput& relayOutput, Scheduler& taskScheduler)
+        : state(systemState), rgbController(rgb), relays(relayOutput), scheduler(taskScheduler) {
+        saveEvent = scheduler.add(saveCallback, this);
+        if (saveEvent == Scheduler::INVALID_HANDLE) {
+            LOG_ERROR("Salida: planificador lleno, no se guardara");
+        }
+    }
+
+    // Al arrancar, con SPIFFS montado y antes de RGBController::begin():
+    // deja la salida guardada pendiente de enviar y pone los relés
+    bool restore() {
+        Record record;
+        if (store.load((uint8_t*)&record, sizeof(record)) != ConfigStore::LOAD_OK) {
+            return false;
+        }
+        rgbController.restoreLevels(record.levels);
+        relays.set(record.relays);
+        saved = record;
+        return true;
+    }
+
+    // Desde la tarea de iluminación cuando la salida no va a cambiar
+    void settled(unsigned long now) {
+        if (scheduler.isScheduled(saveEvent)) return;
+        Record current;
+        capture(current);
+        if (memcmp(&current, &saved, sizeof(current)) != 0) {
+            scheduler.schedule(saveEvent, now + SAVE_DELAY_MS);
+        }
+    }
+};
@@ -0,0 +1,216 @@
+// PWMOutput.h
+#pragma once
+#include <Wire.h>
+
+// Etapa de salida hacia uno o varios PCA9685 encadenados en el mismo bus
+// (direcciones consecutivas desde la primera). Los canales físicos se
+// numeran seguidos: placa * 16 + canal.
+//
+// Guarda una copia (sombra) de los registros PWM ya enviados, y en flush()
+// envía solo los canales que han cambiado, recorriendo todas las placas en
+// una sola pasada. Los canales contiguos de una placa se mandan en una sola
+// transacción I2C aprovechando el auto-incremento del PCA9685.
+class PWMOutput {
+public:
+    static const uint8_t CHANNELS_PER_BOARD = 16;
+    static const uint8_t MAX_BOARDS = 8;
+    static const uint8_t MAX_CHANNELS = CHANNELS_PER_BOARD * MAX_BOARDS;
+    static const uint32_t FAST_MODE_PLUS_HZ = 1000000;  // El PCA9685 admite Fm+
+
+    struct Stats {
+        uint32_t requestedWrites;  // Llamadas a set() (antes, un setPWM cada una)
+        uint32_t transactions;     // Transacciones I2C realmente enviadas
+        uint32_t bytesSent;        // Bytes de datos enviados (registro + valores)
+        uint32_t errors;           // Transacciones fallidas (se reintentan)
+
+        uint32_t savedTransactions() const {
+            return requestedWrites > transactions ? requestedWrites - transactions : 0;
+        }
+        uint32_t savedBytes() const {
+            uint32_t naive = requestedWrites * BYTES_PER_SINGLE_WRITE;
+            return naive > bytesSent ? naive - bytesSent : 0;
+        }
+    };
+
+private:
+    static const uint8_t MODE1 = 0x00;
+    static const uint8_t PRESCALE = 0xFE;
+    static const uint8_t MODE1_SLEEP = 0x10;
+    static const uint8_t MODE1_AI = 0x20;               // Auto-incremento
+    static const uint8_t MODE1_RESTART = 0x80;
+    static const uint32_t OSCILLATOR_HZ = 25000000;
+
+    static const uint8_t LED0_ON_L = 0x06;             // Primer registro de canal
+    static const uint8_t BYTES_PER_CHANNEL = 4;         // ON_L, ON_H, OFF_L, OFF_H
+    static const uint8_t BYTES_PER_SINGLE_WRITE = 1 + BYTES_PER_CHANNEL;
+    static const uint8_t MAX_BURST_CHANNELS = 16;       // 65 bytes, cabe en el buffer de Wire
+
+    // Coste fijo aproximado de una transacción en el driver I2C del ESP32
+    static const uint32_t TRANSACTION_OVERHEAD_US = 20;
+
+    TwoWire& wire;
+    uint8_t firstAddress;
+    uint8_t boardCount;
+    uint32_t busHz = 100000;
+
+    uint16_t shadow[MAX_CHANNELS];            // Último valor confirmado en el PCA9685
+    uint16_t pending[MAX_CHANNELS];           // Valor pedido para el próximo flush
+    uint16_t dirtyMask[MAX_BOARDS] = {};      // Bit i = canal i de la placa pendiente
+
+    Stats stats = {};
+
+    bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+        wire.beginTransmission(address);
+        wire.write(reg);
+        wire.write(value);
+        return wire.endTransmission() == 0;
+    }
+
+    // Envía los canales [first, first + count) de una placa en una sola transacción
+    bool writeBurst(uint8_t board, uint8_t first, uint8_t count) {
+        const uint16_t* values = pending + board * CHANNELS_PER_BOARD;
+        wire.beginTransmission(firstAddress + board);
+        wire.write(LED0_ON_L + BYTES_PER_CHANNEL * first);
+        for (uint8_t ch = first; ch < first + count; ch++) {
+            uint16_t value = values[ch];
+            wire.write(0);              // ON_L
+            wire.write(0);              // ON_H
+            wire.write(value & 0xFF);   // OFF_L
+            wire.write(value >> 8);     // OFF_H
+        }
+        bool ok = wire.endTransmission() == 0;
+
+        stats.transactions++;
+        stats.bytesSent += 1 + BYTES_PER_CHANNEL * count;
+        if (!ok) stats.errors++;
+        return ok;
+    }
+
+    void flushBoard(uint8_t board) {
+        uint16_t& mask = dirtyMask[board];
+        uint16_t* boardShadow = shadow + board * CHANNELS_PER_BOARD;
+        const uint16_t* boardPending = pending + board * CHANNELS_PER_BOARD;
+
+        uint8_t ch = 0;
+        while (mask != 0 && ch < CHANNELS_PER_BOARD) {
+            if (!(mask & (1u << ch))) {
+                ch++;
+                continue;
+            }
+
+            uint8_t first = ch;
+            while (ch < CHANNELS_PER_BOARD && (mask & (1u << ch)) &&
+                   ch - first < MAX_BURST_CHANNELS) {
+                ch++;
+            }
+            uint8_t count = ch - first;
+
+            // Si falla, los canales siguen sucios y se reintentan en el próximo flush
+            if (writeBurst(board, first, count)) {
+                for (uint8_t i = first; i < first + count; i++) {
+                    boardShadow[i] = boardPending[i];
+                    mask &= ~(1u << i);
+                }
+            }
+        }
+    }
+
+public:
+    PWMOutput(TwoWire& i2c, uint8_t boards = 1, uint8_t i2cAddress = 0x40)
+        : wire(i2c), firstAddress(i2cAddress),
+          boardCount(boards < 1 ? 1 : (boards > MAX_BOARDS ? MAX_BOARDS : boards)) {
+        for (uint8_t i = 0; i < MAX_CHANNELS; i++) {
+            shadow[i] = pending[i] = 0;
+        }
+    }
+
+    // Configura el bus y todas las placas: frecuencia PWM, auto-incremento.
+    // Los canales quedan pendientes de enviar en el próximo flush()
+    void begin(float pwmFrequency, uint32_t i2cHz = FAST_MODE_PLUS_HZ) {
+        busHz = i2cHz;
+        wire.setClock(i2cHz);
+
+        uint8_t prescale = (uint8_t)(OSCILLATOR_HZ / (4096.0f * pwmFrequency) + 0.5f) - 1;
+        for (uint8_t board = 0; board < boardCount; board++) {
+            uint8_t address = firstAddress + board;
+            writeRegister(address, MODE1, MODE1_SLEEP);  // El prescaler solo se cambia dormido
+            writeRegister(address, PRESCALE, prescale);
+            writeRegister(address, MODE1, MODE1_AI);
+            delay(1);                                    // Arranque del oscilador
+            writeRegister(address, MODE1, MODE1_AI | MODE1_RESTART);
+        }
+        invalidate();
+    }
+
+    uint8_t getBoardCount() const {
+        return boardCount;
+    }
+
+    uint8_t getChannelCount() const {
+        return boardCount * CHANNELS_PER_BOARD;
+    }
+
+    // Fuerza el envío de todos los canales en el próximo flush()
+    void invalidate() {
+        for (uint8_t board = 0; board < boardCount; board++) {
+            dirtyMask[board] = 0xFFFF;
+        }
+    }
+
+    void set(uint8_t channel, uint16_t value) {
+        if (channel >= getChannelCount()) return;
+
+        stats.requestedWrites++;
+        pending[channel] = value;
+        uint16_t bit = 1u << (channel % CHANNELS_PER_BOARD);
+        if (value != shadow[channel]) {
+            dirtyMask[channel / CHANNELS_PER_BOARD] |= bit;
+        } else {
+            dirtyMask[channel / CHANNELS_PER_BOARD] &= ~bit;
+        }
+    }
+
+    uint16_t get(uint8_t channel) const {
+        return channel < getChannelCount() ? pending[channel] : 0;
+    }
+
+    bool isDirty() const {
+        for (uint8_t board = 0; board < boardCount; board++) {
+            if (dirtyMask[board] != 0) return true;
+        }
+        return false;
+    }
+
+    // Envía los canales cambiados de todas las placas, en ráfagas
+    void flush() {
+        for (uint8_t board = 0; board < boardCount; board++) {
+            if (dirtyMask[board] != 0) {
+                flushBoard(board);
+            }
+        }
+    }
+
+    // Frames por segundo alcanzables a 'i2cHz' si cambian 'channels' canales
+    // en cada frame (el peor caso: una ráfaga por placa con todos sus canales).
+    // Cada byte son 9 bits en el bus (8 + ACK), más inicio y parada.
+    static uint32_t achievableFrameRate(uint16_t channels, uint32_t i2cHz) {
+        if (channels == 0) return 0;
+        uint32_t boards = (channels + CHANNELS_PER_BOARD - 1) / CHANNELS_PER_BOARD;
+        uint32_t bytes = boards * 2 + channels * BYTES_PER_CHANNEL;  // Dirección + registro + datos
+        uint32_t bits = bytes * 9 + boards * 2;
+        uint32_t frameUs = boards * TRANSACTION_OVERHEAD_US + (uint32_t)((uint64_t)bits * 1000000 / i2cHz);
+        return frameUs > 0 ? 1000000 / frameUs : 0;
+    }
+
+    uint32_t getBusHz() const {
+        return busHz;
+    }
+
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    void resetStats() {
+        stats = {};
+    }
+};
@@ -1,56 +1,90 @@
 #pragma once
+#include <atomic>
 #include "SystemState.h"
 #include "RGBController.h"
-#include <SPIFFS.h>
-#include <FS.h>
+#include "ConfigStore.h"
+#include "Timeline.h"
+#include "WallClock.h"
+#include "Easing.h"
+#include "Scheduler.h"
+#include "RelayOutput.h"
+#include "SeqLock.h"
+#include "Log.h"
 
-// Usamos el namespace para File
-using fs::File;
 
+// Configuración de una fase. Tipo plano: se guarda tal cual en /phases.cfg
+struct PhaseConfig {
+    struct Rgb {
+        uint8_t r, g, b;
+    };
+
+    Rgb rgb[NUM_RGB];
+    uint8_t auxiliary[NUM_AUX];
+    bool relay[2];              // Dos relés
+    uint8_t easing;             // Easing::Curve de la transición a la siguiente fase
+    unsigned long duration;     // Duración de la fase en milisegundos
+    unsigned long crossFade;    // Duración de la transición a la siguiente fase
+};
 
+// Fases por defecto, en flash: PhaseController las lee directamente de
+// aquí hasta que se configura o se carga alguna
+static constexpr PhaseConfig DEFAULT_PHASES[] = {
+    // RGB1, RGB2, auxiliares, relés, curva, duración, transición (5 s)
+    {{{0, 0, 0}, {0, 0, 0}}, {0, 0, 0, 0, 0}, {false, false}, Easing::LINEAR, 0, 5000},                  // Apagado
+    {{{255, 150, 50}, {200, 100, 50}}, {50, 0, 0, 0, 0}, {false, false}, Easing::LINEAR, 0, 5000},       // Alba
+    {{{255, 255, 255}, {255, 255, 255}}, {255, 255, 0, 0, 0}, {false, false}, Easing::LINEAR, 0, 5000},  // Día
+    {{{255, 200, 150}, {255, 180, 120}}, {150, 0, 0, 0, 0}, {false, false}, Easing::LINEAR, 0, 5000},    // Tarde
+    {{{50, 50, 150}, {30, 30, 100}}, {20, 0, 0, 0, 0}, {false, false}, Easing::LINEAR, 0, 5000},         // Noche
+};
+static_assert(sizeof(DEFAULT_PHASES) / sizeof(DEFAULT_PHASES[0]) == NUM_PHASES,
+              "DEFAULT_PHASES debe tener NUM_PHASES fases");
+
+// Cada instancia es una zona (ZONE_LAYOUTS): fases, línea de tiempo,
+// reloj y ficheros propios, y solo escribe los canales y relés de la zona.
 class PhaseController {
+public:
+    typedef PhaseConfig PhaseTable[NUM_PHASES];
+
+    // Eventos que registra cada zona en el planificador de su tarea
+    static const uint8_t SCHEDULER_EVENTS = 5;
+
 private:
-    // Primero definimos la estructura PhaseConfig que necesitamos para todo lo demás
-    struct PhaseConfig {
-        // Estructura para RGB
-        struct {
-            uint8_t r, g, b;
-        } rgb[2];  // Array de dos elementos para los dos canales RGB
-        
-        uint8_t auxiliary[5];  // Cinco canales auxiliares
-        bool relay[2];         // Dos relés
-        unsigned long duration; // Duración de la fase en milisegundos
-        unsigned long crossFade;     // Duración de la transición a la siguiente fase
-        
-        // Constructor con valores predeterminados
-        /*PhaseConfig() : duration(0) {
-            for(int i = 0; i < 2; i++) {
-                rgb[i] = {0, 0, 0};
-            }
-            for(int i = 0; i < 5; i++) {
-                auxiliary[i] = 0;
-            }
-            relay[0] = relay[1] = false;
-        }*/
-        PhaseConfig() : duration(0), crossFade(5000) {  // Por defecto 5 segundos de transición
-        for(int i = 0; i < 2; i++) {
-            rgb[i] = {0, 0, 0};
-        }
-        for(int i = 0; i < 5; i++) {
-            auxiliary[i] = 0;
-        }
-        relay[0] = relay[1] = false;
-        }
-    };
+    static_assert(NUM_PHASES >= 2 && NUM_PHASES < Timeline::NO_LABEL, "número de fases fuera de rango");
 
     // Referencias a otros controladores
     SystemState& state;
     RGBController& rgbController;
+    RelayOutput& relays;
+
+    const uint8_t zone;         // Índice en ZONE_LAYOUTS y SystemState::zones
+    const ZoneLayout layout;
+
+    // Lo que no es por frame va en el planificador de la tarea: inicio de
+    // cada keyframe (relés), fin de la transición manual, guardados y debug
+    Scheduler& scheduler;
+    Scheduler::Handle keyframeEvent;
+    Scheduler::Handle transitionEvent;
+    Scheduler::Handle saveEvent;
+    Scheduler::Handle timelineSaveEvent;
+    Scheduler::Handle debugEvent;
+    static const uint32_t DEBUG_PERIOD_MS = 1000;
     
     // Variables de control de secuencia
     bool sequenceRunning = false;
-    unsigned long phaseStartTime = 0;
-    uint8_t currentPhaseIndex = 0;
+    unsigned long sequenceStartTime = 0;
+
+    // Con una línea de tiempo anclada la salida depende solo de la hora
+    // del día: no hay estado que reconstruir al reanudar
+    WallClock clock;
+
+    // Mientras otro modo (p. ej. el reactivo al audio) maneja la salida, la
+    // secuencia sigue su curso pero no escribe
+    bool outputSuspended = false;
+
+    // Último segmento aplicado; mientras se mantiene sin fundido no se reescribe
+    static const uint16_t NO_SEGMENT = 0xFFFF;
+    uint16_t lastSegment = NO_SEGMENT;
+    bool lastWasFading = false;
     
     // Variables para control de transiciones
     unsigned long transitionStartTime = 0;
@@ -59,209 +93,735 @@ private:
     uint8_t toPhase = 0;
     bool inTransition = false;
     
-    // Constantes de la secuencia
+    // Fases que forman la línea de tiempo generada a partir de las fases
     static const uint8_t FIRST_SEQUENCE_PHASE = 1;  // Comenzamos desde Alba
-    static const uint8_t LAST_SEQUENCE_PHASE = 4;   // Terminamos en Noche
+    static const uint8_t LAST_SEQUENCE_PHASE = NUM_PHASES - 1;  // Terminamos en Noche
     
-    // Almacenamiento de las configuraciones de fase
-    PhaseConfig phases[5];  // 5 fases: Apagado, Alba, Día, Tarde, Noche
+    // Configuraciones de fase, con copia en escritura: un cambio se prepara
+    // en la tabla que no está activa y se publica cambiando el puntero, así
+    // update() nunca ve un cambio a medias. Apunta a DEFAULT_PHASES (flash)
+    // hasta el primer cambio o carga.
+    std::atomic<const PhaseConfig*> activePhases{DEFAULT_PHASES};
+    PhaseConfig phaseTables[2][NUM_PHASES];
+
+    // Copia para las demás tareas (pantalla, ProfileLibrary): con solo dos
+    // tablas, la publicada vuelve a ser la de trabajo dos cambios después,
+    // quizá con un lector a medias; ellos leen esta con readPhases()
+    SeqLock<PhaseTable> publishedPhases;
+
+    // Niveles 8.8 de toda la salida
+    struct Levels {
+        uint16_t rgb[NUM_RGB][3];
+        uint16_t auxiliary[NUM_AUX];
+    };
+
+    // Último nivel escrito por la secuencia o la transición
+    Levels output = {};
+
+    // Un cambio de configuración durante un fundido lo re-basa: el resto
+    // del fundido va desde la salida de ese momento hasta el nuevo destino
+    // con el progreso que quedaba, sin saltos
+    static const uint16_t TRANSITION_FADE = 0xFFFE;  // Clave de la transición manual
+    static const uint32_t NO_PROGRESS = 0xFFFFFFFF;
+    bool rebased = false;
+    uint16_t rebaseFade = NO_SEGMENT;                // Segmento (o TRANSITION_FADE)
+    uint32_t rebaseProgress = NO_PROGRESS;           // Progreso al capturar rebaseFrom
+    Levels rebaseFrom;
+
+    // Cambio de perfil: durante profileFadeDuration ms la salida se mezcla
+    // desde la que había al cambiar hacia la que toque en cada frame
+    Levels profileFadeFrom;
+    unsigned long profileFadeStart = 0;
+    uint32_t profileFadeDuration = 0;           // 0 = sin fundido de perfil
+
+    // Ficheros de la zona: la zona 1 conserva los nombres de siempre
+    // (/phases.cfg), las demás llevan su número (/phases2.cfg)
+    char phasePath[16];
+    char phaseTempPath[16];
+    char timelinePath[16];
+    char timelineTempPath[16];
+
+    static const char* zonePath(char* buffer, const char* base, uint8_t zoneIndex, const char* extension) {
+        if (zoneIndex == 0) {
+            snprintf(buffer, 16, "%s%s", base, extension);
+        } else {
+            snprintf(buffer, 16, "%s%u%s", base, zoneIndex + 1, extension);
+        }
+        return buffer;
+    }
+
+    // Persistencia en /phases.cfg (cabecera "PHC1" y phases[] en crudo).
+    // Versión 2: con curva; en la 1 ese byte era relleno sin inicializar.
+    static const uint32_t CONFIG_MAGIC = 0x31434850;
+    static const uint16_t CONFIG_VERSION = 2;
+    static const uint16_t CONFIG_VERSION_NO_EASING = 1;
+    ConfigStore store;
+
+    // Línea de tiempo activa y la que se está cargando; al confirmar una
+    // carga se intercambian los punteros, así update() nunca ve una a medias
+    Timeline timelines[2];
+    Timeline* activeTimeline = &timelines[0];
+    Timeline* stagingTimeline = &timelines[1];
+
+    // Persistencia en /timeline.cfg (cabecera "TLN1")
+    static const uint32_t TIMELINE_MAGIC = 0x314E4C54;
+    static const uint16_t TIMELINE_VERSION = 1;
+    ConfigStore timelineStore;
+
+    bool ownsRgb(uint8_t i) const {
+        return layout.rgbMask & (1 << i);
+    }
+
+    bool ownsAux(uint8_t i) const {
+        return layout.auxMask & (1 << i);
+    }
 
     // Métodos privados
     void loadDefaultPhases() {
-        // Fase 0 - Apagado (ya configurada por el constructor)
-        
-        // Fase 1 - Alba
-        phases[1].rgb[0] = {255, 150, 50};
-        phases[1].rgb[1] = {200, 100, 50};
-        phases[1].auxiliary[0] = 50;
-        
-        // Fase 2 - Día
-        phases[2].rgb[0] = {255, 255, 255};
-        phases[2].rgb[1] = {255, 255, 255};
-        phases[2].auxiliary[0] = 255;
-        phases[2].auxiliary[1] = 255;
-        
-        // Fase 3 - Tarde
-        phases[3].rgb[0] = {255, 200, 150};
-        phases[3].rgb[1] = {255, 180, 120};
-        phases[3].auxiliary[0] = 150;
-        
-        // Fase 4 - Noche
-        phases[4].rgb[0] = {50, 50, 150};
-        phases[4].rgb[1] = {30, 30, 100};
-        phases[4].auxiliary[0] = 20;
+        publishPhases(DEFAULT_PHASES);
+    }
+
+    void publishPhases(const PhaseConfig* table) {
+        activePhases.store(table, std::memory_order_release);
+        publishedPhases.write(*(const PhaseTable*)table);
+    }
+
+    const PhaseConfig* phases() const {
+        return activePhases.load(std::memory_order_acquire);
+    }
+
+    // Tabla libre para preparar un cambio: la que no está activa
+    PhaseConfig* spareTable() {
+        return phases() == phaseTables[0] ? phaseTables[1] : phaseTables[0];
+    }
+
+    // Copia de trabajo con el contenido de la tabla activa
+    PhaseConfig* beginPhaseEdit() {
+        PhaseConfig* edit = spareTable();
+        memcpy(edit, phases(), sizeof(phaseTables[0]));
+        return edit;
+    }
+
+    // Publica la copia de una vez. El fundido en curso se re-basa y la
+    // línea de tiempo generada a partir de las fases se regenera.
+    void commitPhaseEdit(const PhaseConfig* edit) {
+        startRebase();
+        publishPhases(edit);
+        state.zones[zone].profile = NO_PROFILE;
+        if (activeTimeline->isFromPhases()) {
+            buildTimelineFromPhases();
+            requestTimelineSave();
+        }
+    }
+
+    void startRebase() {
+        if (inTransition || lastWasFading) {
+            rebaseFrom = output;
+            rebaseFade = inTransition ? TRANSITION_FADE : lastSegment;
+            rebaseProgress = NO_PROGRESS;
+            rebased = true;
+        }
+        lastSegment = NO_SEGMENT;  // Una fase mantenida se reescribe con el cambio
+    }
+
+    // Escribe los niveles del frame. Con un re-base activo se mezclan desde
+    // la salida capturada, con el progreso que quedaba del fundido 'fade'.
+    void writeLevels(Levels& levels, uint16_t fade, uint32_t progress, bool fading) {
+        if (rebased && (!fading || fade != rebaseFade)) {
+            rebased = false;
+        }
+        if (rebased) {
+            // Primer frame tras el cambio, o un cambio de duración que ha
+            // hecho retroceder el progreso: se parte de la salida actual
+            if (rebaseProgress == NO_PROGRESS || progress < rebaseProgress) {
+                if (rebaseProgress != NO_PROGRESS) rebaseFrom = output;
+                rebaseProgress = progress;
+            }
+            uint32_t remaining = 65536 - rebaseProgress;
+            uint32_t blend = remaining == 0 ? 65536
+                : ((uint64_t)(progress - rebaseProgress) << 16) / remaining;
+
+            for (int i = 0; i < NUM_RGB; i++) {
+                for (int c = 0; c < 3; c++) {
+                    levels.rgb[i][c] = GammaTable::blendLevels(rebaseFrom.rgb[i][c], levels.rgb[i][c], blend);
+                }
+            }
+            for (int i = 0; i < NUM_AUX; i++) {
+                levels.auxiliary[i] = GammaTable::blendLevels(rebaseFrom.auxiliary[i], levels.auxiliary[i], blend);
+            }
+        }
+        if (profileFadeDuration > 0) {
+            uint32_t elapsed = millis() - profileFadeStart;
+            if (elapsed >= profileFadeDuration) {
+                profileFadeDuration = 0;  // Este frame ya escribe el destino
+            } else {
+                uint32_t blend = ((uint64_t)elapsed << 16) / profileFadeDuration;
+                for (int i = 0; i < NUM_RGB; i++) {
+                    for (int c = 0; c < 3; c++) {
+                        levels.rgb[i][c] = GammaTable::blendLevels(profileFadeFrom.rgb[i][c], levels.rgb[i][c], blend);
+                    }
+                }
+                for (int i = 0; i < NUM_AUX; i++) {
+                    levels.auxiliary[i] = GammaTable::blendLevels(profileFadeFrom.auxiliary[i], levels.auxiliary[i], blend);
+                }
+            }
+        }
+
+        for (int i = 0; i < NUM_RGB; i++) {
+            if (ownsRgb(i)) rgbController.setRGBLevels(i, levels.rgb[i][0], levels.rgb[i][1], levels.rgb[i][2]);
+        }
+        for (int i = 0; i < NUM_AUX; i++) {
+            if (ownsAux(i)) rgbController.setAuxiliaryLevel(i, levels.auxiliary[i]);
+        }
+        output = levels;
+    }
+
+    // Función auxiliar para interpolar valores en punto fijo:
+    // progreso Q16 (0-65536), resultado en nivel 8.8 para la tabla gamma
+    uint16_t interpolate(uint8_t start, uint8_t end, uint32_t progress) {
+        return GammaTable::interpolateLevel(start, end, progress);
+    }
+
+    // Instante dentro del ciclo. Anclada y con reloj: hora del día, que
+    // Timeline reduce al período; con un período distinto de un día el
+    // ciclo se repite a lo largo del día contando desde medianoche (véase
+    // checkAnchoredPeriod()). Si no, tiempo desde PLAY (los ciclos completos se pasan a
+    // sequenceStartTime para sobrevivir al desbordamiento de millis()).
+    uint32_t sequenceTime(unsigned long now) {
+        if (activeTimeline->isAnchored() && clock.isSet()) {
+            return clock.timeOfDay(now);
+        }
+        uint32_t elapsed = now - sequenceStartTime;
+        uint32_t period = activeTimeline->getPeriod();
+        if (period > 0 && elapsed >= period) {
+            sequenceStartTime += elapsed - elapsed % period;
+            elapsed %= period;
+        }
+        return elapsed;
+    }
+
+    void swapTimelines() {
+        Timeline* previous = activeTimeline;
+        activeTimeline = stagingTimeline;
+        stagingTimeline = previous;
+        lastSegment = NO_SEGMENT;
+        if (activeTimeline->getPeriod() != previous->getPeriod()) {
+            checkAnchoredPeriod();
+        }
+        armKeyframeEvent();
+    }
+
+    // Anclada, una línea de tiempo más corta que un día se repite desde
+    // medianoche (una nube de una hora, 24 veces). Se avisa porque con el
+    // programa de fases suele ser un error, y si el período no divide el
+    // día el último ciclo queda cortado y a medianoche la salida salta.
+    void checkAnchoredPeriod() {
+        if (!activeTimeline->isAnchored() || activeTimeline->isEmpty()) return;
+        uint32_t period = activeTimeline->getPeriod();
+        if (period == WallClock::DAY_MS) return;
+        if (WallClock::DAY_MS % period == 0) {
+            LOG_INFO("Zona %u: Modo reloj: el ciclo de %lu ms se repite %lu veces al dia",
+                     zone + 1, (unsigned long)period, (unsigned long)(WallClock::DAY_MS / period));
+        } else {
+            LOG_WARN("Zona %u: Modo reloj: el ciclo de %lu ms no divide el dia; salto a medianoche",
+                     zone + 1, (unsigned long)period);
+        }
+    }
+
+    // El evento de keyframe se dispara ya y desde ahí se encadena al inicio
+    // de cada keyframe siguiente; sin secuencia no hay nada que esperar
+    void armKeyframeEvent() {
+        if (sequenceRunning && !activeTimeline->isEmpty()) {
+            scheduler.schedule(keyframeEvent, millis());
+        } else {
+            scheduler.cancel(keyframeEvent);
+        }
+    }
+
+    // Inicio de un keyframe: relés del keyframe y cita con el siguiente
+    void onKeyframe() {
+        unsigned long now = millis();
+        uint32_t t = sequenceTime(now);
+        const Timeline::Keyframe& keyframe = activeTimeline->at(activeTimeline->findSegment(t % activeTimeline->getPeriod()));
+        relays.set(keyframe.relays, layout.relayMask);
+        scheduler.schedule(keyframeEvent, now + activeTimeline->timeToNextKeyframe(t));
+    }
+
+    void onTransitionEnd() {
+        inTransition = false;
+        lastSegment = NO_SEGMENT;  // La secuencia vuelve a escribir su salida
+        if (!outputSuspended) {
+            applyPhase(toPhase);
+        }
+        LOG_INFO("Zona %u: Transición completada", zone + 1);
     }
 
-    // Función auxiliar para interpolar valores
-    uint8_t interpolate(uint8_t start, uint8_t end, float progress) {
-        return start + (end - start) * progress;
+    void printDebug() {
+        LOG_DEBUG("Zona %u: Sequence=%d, Transition=%d, Keyframe=%u/%u, Time=%lu",
+                  zone + 1, sequenceRunning, inTransition, state.zones[zone].currentKeyframe,
+                  activeTimeline->size(), (unsigned long)sequenceTime(millis()));
+    }
+
+    // Guardado diferido: una sola escritura tras una ráfaga de cambios
+    void onSaveDue() {
+        if (store.isSaveDue(millis())) saveToSPIFFS();
+    }
+
+    void onTimelineSaveDue() {
+        if (timelineStore.isSaveDue(millis())) saveTimeline();
+    }
+
+    // Adaptadores para Scheduler::Callback
+    static void keyframeCallback(void* self) { static_cast<PhaseController*>(self)->onKeyframe(); }
+    static void transitionCallback(void* self) { static_cast<PhaseController*>(self)->onTransitionEnd(); }
+    static void saveCallback(void* self) { static_cast<PhaseController*>(self)->onSaveDue(); }
+    static void timelineSaveCallback(void* self) { static_cast<PhaseController*>(self)->onTimelineSaveDue(); }
+    static void debugCallback(void* self) { static_cast<PhaseController*>(self)->printDebug(); }
+
+    // Genera la línea de tiempo clásica: Alba, Día, Tarde y Noche seguidas
+    // según sus duraciones. Las fases con duración 0 no entran.
+    void buildTimelineFromPhases() {
+        uint32_t period = 0;
+        for (uint8_t p = FIRST_SEQUENCE_PHASE; p <= LAST_SEQUENCE_PHASE; p++) {
+            period += phases()[p].duration;
+        }
+
+        stagingTimeline->clear(period);
+        stagingTimeline->setFromPhases(true);
+        stagingTimeline->setAnchored(activeTimeline->isAnchored());
+
+        uint32_t time = 0;
+        for (uint8_t p = FIRST_SEQUENCE_PHASE; p <= LAST_SEQUENCE_PHASE; p++) {
+            if (phases()[p].duration == 0) continue;
+
+            Timeline::Keyframe keyframe = {};
+            keyframe.time = time;
+            keyframe.crossFade = phases()[p].crossFade;
+            for (int i = 0; i < NUM_RGB; i++) {
+                keyframe.rgb[i][0] = phases()[p].rgb[i].r;
+                keyframe.rgb[i][1] = phases()[p].rgb[i].g;
+                keyframe.rgb[i][2] = phases()[p].rgb[i].b;
+            }
+            memcpy(keyframe.auxiliary, phases()[p].auxiliary, NUM_AUX);
+            keyframe.relays = (phases()[p].relay[0] ? 1 : 0) | (phases()[p].relay[1] ? 2 : 0);
+            keyframe.label = p;
+            keyframe.easing = phases()[p].easing;
+            stagingTimeline->insert(keyframe);
+
+            time += phases()[p].duration;
+        }
+
+        swapTimelines();
+    }
+
+    // Escribe la salida del instante evaluado. Mientras se mantiene el mismo
+    // keyframe sin fundido no hay nada que escribir.
+    void applySample(const Timeline::Sample& sample) {
+        if (!sample.fading && !lastWasFading && sample.segment == lastSegment && profileFadeDuration == 0) {
+            return;
+        }
+
+        const Timeline::Keyframe& to = activeTimeline->at(sample.segment);
+        const Timeline::Keyframe& from = sample.fading ? activeTimeline->at(sample.from) : to;
+        uint32_t progress = sample.fading ? Easing::apply(from.easing, sample.progressQ16) : 65536;
+
+        Levels levels;
+        for (int i = 0; i < NUM_RGB; i++) {
+            for (int c = 0; c < 3; c++) {
+                levels.rgb[i][c] = interpolate(from.rgb[i][c], to.rgb[i][c], progress);
+            }
+        }
+        for (int i = 0; i < NUM_AUX; i++) {
+            levels.auxiliary[i] = interpolate(from.auxiliary[i], to.auxiliary[i], progress);
+        }
+        writeLevels(levels, sample.segment, progress, sample.fading);
+
+        state.zones[zone].currentPhase = to.label;
+        state.zones[zone].currentKeyframe = sample.segment;
+        state.zones[zone].keyframeCount = activeTimeline->size();
+
+        lastSegment = sample.segment;
+        lastWasFading = sample.fading;
     }
 
 public:
+    // Solo desde la tarea de iluminación; las demás usan readPhases()
     const PhaseConfig& getPhaseConfig(uint8_t phase) const {
-        return phases[phase];
+        return phases()[phase];
+    }
+
+    // Copia coherente de las fases en uso, desde cualquier tarea
+    void readPhases(PhaseTable& out) const {
+        publishedPhases.read(out);
     }
     // Constructor
-    PhaseController(SystemState& systemState, RGBController& rgb)
-        : state(systemState), rgbController(rgb) {
+    PhaseController(SystemState& systemState, RGBController& rgb,
+                     RelayOutput& relayOutput, Scheduler& taskScheduler, uint8_t zoneIndex = 0)
+        : state(systemState), rgbController(rgb), relays(relayOutput),
+          zone(zoneIndex), layout(ZONE_LAYOUTS[zoneIndex]), scheduler(taskScheduler),
+          store(zonePath(phasePath, "/phases", zoneIndex, ".cfg"),
+                zonePath(phaseTempPath, "/phases", zoneIndex, ".tmp"), CONFIG_MAGIC, CONFIG_VERSION),
+          timelineStore(zonePath(timelinePath, "/timeline", zoneIndex, ".cfg"),
+                        zonePath(timelineTempPath, "/timeline", zoneIndex, ".tmp"), TIMELINE_MAGIC, TIMELINE_VERSION) {
+        keyframeEvent = scheduler.add(keyframeCallback, this);
+        transitionEvent = scheduler.add(transitionCallback, this);
+        saveEvent = scheduler.add(saveCallback, this);
+        timelineSaveEvent = scheduler.add(timelineSaveCallback, this);
+        debugEvent = scheduler.add(debugCallback, this);
+        // Sin hueco falla el último add() aunque sea otro el que no cupo
+        if (debugEvent == Scheduler::INVALID_HANDLE) {
+            LOG_ERROR("Zona %u: planificador lleno, sin eventos de secuencia", zone + 1);
+        }
+        scheduler.schedule(debugEvent, millis() + DEBUG_PERIOD_MS, DEBUG_PERIOD_MS);
+
         loadDefaultPhases();
+        buildTimelineFromPhases();
     }
 
     // Métodos de control de secuencia
     void startSequence() {
+        if (activeTimeline->isEmpty()) {
+            LOG_WARN("Zona %u: Secuencia sin keyframes ni duraciones configuradas", zone + 1);
+            return;
+        }
+        if (activeTimeline->isAnchored() && !clock.isSet()) {
+            LOG_WARN("Zona %u: Reloj sin ajustar: la secuencia empieza desde el inicio", zone + 1);
+        }
         sequenceRunning = true;
-        currentPhaseIndex = FIRST_SEQUENCE_PHASE;
-        phaseStartTime = millis();
-        applyPhase(currentPhaseIndex);
-        Serial.println("Secuencia iniciada desde fase Alba");
+        sequenceStartTime = millis();
+        lastSegment = NO_SEGMENT;
+        armKeyframeEvent();
+        LOG_INFO("Zona %u: Secuencia iniciada (%u keyframes)", zone + 1, activeTimeline->size());
     }
 
     void stopSequence() {
         sequenceRunning = false;
-        Serial.println("Secuencia detenida");
+        armKeyframeEvent();
+        LOG_INFO("Zona %u: Secuencia detenida", zone + 1);
     }
 
     bool isSequenceRunning() const {
         return sequenceRunning;
     }
 
+    // ms durante los que la salida no va a cambiar sin nuevas órdenes: 0 en
+    // un fundido; en una secuencia parada, hasta el próximo keyframe (ahí
+    // empieza su fundido). Lo usa la tarea para dormir entre frames.
+    uint32_t quietTime(unsigned long now) {
+        if (outputSuspended) return Scheduler::NO_DEADLINE;
+        if (inTransition) return 0;
+        if (!sequenceRunning || activeTimeline->isEmpty()) return Scheduler::NO_DEADLINE;
+        if (profileFadeDuration > 0) return 0;
+        uint32_t t = sequenceTime(now);
+        if (activeTimeline->sample(t).fading) return 0;
+        return activeTimeline->timeToNextKeyframe(t);
+    }
+
     // Métodos de control de fases
     void configurePhase(uint8_t phase, 
-                   uint8_t r1, uint8_t g1, uint8_t b1,
-                   uint8_t r2, uint8_t g2, uint8_t b2,
+                   const uint8_t (*rgbValues)[3],
                    const uint8_t* auxValues,
                    unsigned long phaseDuration,
-                   unsigned long crossFade){
-        if (phase >= 5) return;
+                   unsigned long crossFade,
+                   uint8_t easing = Easing::LINEAR){
+        if (phase >= NUM_PHASES) return;
         
-        phases[phase].rgb[0] = {r1, g1, b1};
-        phases[phase].rgb[1] = {r2, g2, b2};
+        PhaseConfig* edit = beginPhaseEdit();
+        PhaseConfig& config = edit[phase];
+        for (int i = 0; i < NUM_RGB; i++) {
+            config.rgb[i] = {rgbValues[i][0], rgbValues[i][1], rgbValues[i][2]};
+        }
         
-        for(int i = 0; i < 5; i++) {
-            phases[phase].auxiliary[i] = auxValues[i];
+        for(int i = 0; i < NUM_AUX; i++) {
+            config.auxiliary[i] = auxValues[i];
         }
 
-        phases[phase].duration = phaseDuration;
-        phases[phase].crossFade = crossFade;
+        config.duration = phaseDuration;
+        config.crossFade = crossFade;
+        config.easing = easing < Easing::CURVE_COUNT ? easing : (uint8_t)Easing::LINEAR;
         
-        Serial.printf("Fase %d configurada: RGB1(%d,%d,%d) RGB2(%d,%d,%d) Duracion:%lu\n Transicion:%lu\n",
-                     phase, r1, g1, b1, r2, g2, b2, phaseDuration, crossFade);
+        LOG_INFO("Fase %d configurada: RGB1(%d,%d,%d) Duracion:%lu Transicion:%lu",
+                 phase, rgbValues[0][0], rgbValues[0][1], rgbValues[0][2], phaseDuration, crossFade);
+
+        commitPhaseEdit(edit);
+    }
+
+    // Cambia un solo campo de una fase: un nivel (canal lógico 0 a
+    // NUM_LOGICAL_CHANNELS - 1) o PHASE_FIELD_DURATION/CROSSFADE/EASING
+    bool setPhaseField(uint8_t phase, uint8_t field, uint32_t value) {
+        if (phase >= NUM_PHASES || field >= PHASE_FIELD_COUNT) return false;
+        if (field < PHASE_FIELD_DURATION && value > 255) return false;
+        if (field == PHASE_FIELD_EASING && value >= Easing::CURVE_COUNT) return false;
+
+        PhaseConfig* edit = beginPhaseEdit();
+        PhaseConfig& config = edit[phase];
+        if (field < NUM_RGB * 3) {
+            PhaseConfig::Rgb& rgb = config.rgb[field / 3];
+            uint8_t& component = field % 3 == 0 ? rgb.r : (field % 3 == 1 ? rgb.g : rgb.b);
+            component = value;
+        } else if (field < PHASE_FIELD_DURATION) {
+            config.auxiliary[field - NUM_RGB * 3] = value;
+        } else if (field == PHASE_FIELD_DURATION) {
+            config.duration = value;
+        } else if (field == PHASE_FIELD_CROSSFADE) {
+            config.crossFade = value;
+        } else {
+            config.easing = value;
+        }
+        commitPhaseEdit(edit);
+
+        LOG_INFO("Zona %u: Fase %u: campo %u = %lu", zone + 1, phase, field, (unsigned long)value);
+        return true;
+    }
+
+    // Cambio de perfil: se publica la tabla tal cual (vive en
+    // ProfileLibrary, sin copiarla) y la salida funde hacia ella en 'fade'
+    // ms (solo si la zona está mostrando sus fases; si no, no hay nada que
+    // fundir). Una línea de tiempo generada a partir de las fases se
+    // regenera; una cargada por keyframes no cambia. Las fases se guardan
+    // en el fichero de la zona para arrancar con este perfil.
+    void useProfile(const PhaseConfig* table, uint8_t profile, uint32_t fade) {
+        bool showing = (sequenceRunning || inTransition) && !outputSuspended;
+        profileFadeFrom = output;
+        profileFadeStart = millis();
+        profileFadeDuration = showing ? fade : 0;
+        rebased = false;
+        lastSegment = NO_SEGMENT;
+        publishPhases(table);
+        if (activeTimeline->isFromPhases()) {
+            buildTimelineFromPhases();
+            requestTimelineSave();
+        }
+        requestSave();
+        state.zones[zone].profile = profile;
+        LOG_INFO("Zona %u: Perfil %u en uso (fundido de %lu ms)", zone + 1, profile + 1, (unsigned long)fade);
+    }
+
+    // true si la zona lee sus fases de 'table'; desde cualquier tarea
+    bool usesPhases(const PhaseConfig* table) const {
+        return phases() == table;
+    }
+
+    // Carga de una línea de tiempo nueva: begin, keyframes y commit.
+    // Mientras tanto la secuencia sigue con la línea de tiempo activa.
+    void beginTimeline(uint32_t period) {
+        stagingTimeline->clear(period);
+        stagingTimeline->setAnchored(activeTimeline->isAnchored());
+    }
+
+    // Puesta en hora: la salida salta directamente al punto correcto
+    void setClock(uint32_t timeOfDayMs) {
+        clock.set(timeOfDayMs, millis());
+        lastSegment = NO_SEGMENT;
+        LOG_INFO("Zona %u: Reloj: %02lu:%02lu:%02lu", zone + 1,
+                 (unsigned long)(timeOfDayMs / 3600000),
+                 (unsigned long)(timeOfDayMs / 60000 % 60),
+                 (unsigned long)(timeOfDayMs / 1000 % 60));
+
+        // Una línea de tiempo anclada se reanuda sola al conocer la hora
+        if (activeTimeline->isAnchored() && !activeTimeline->isEmpty()) {
+            sequenceRunning = true;
+        }
+        armKeyframeEvent();
+    }
+
+    // Ancla (o suelta) la línea de tiempo a la hora del día; se guarda
+    // con ella, así que tras reiniciar basta con poner el reloj en hora
+    void setClockMode(bool anchored) {
+        activeTimeline->setAnchored(anchored);
+        lastSegment = NO_SEGMENT;
+        requestTimelineSave();
+        if (anchored && !clock.isSet()) {
+            LOG_WARN("Zona %u: Modo reloj: pendiente de poner en hora", zone + 1);
+        }
+        checkAnchoredPeriod();
+    }
+
+    bool addKeyframe(const Timeline::Keyframe& keyframe) {
+        if (!stagingTimeline->insert(keyframe)) {
+            LOG_WARN("Zona %u: Keyframe en %lu rechazado", zone + 1, (unsigned long)keyframe.time);
+            return false;
+        }
+        return true;
+    }
+
+    void commitTimeline() {
+        if (stagingTimeline->isEmpty()) {
+            LOG_WARN("Zona %u: Linea de tiempo vacia, se mantiene la actual", zone + 1);
+            return;
+        }
+        swapTimelines();
+        requestTimelineSave();
+        LOG_INFO("Zona %u: Linea de tiempo cargada: %u keyframes", zone + 1, activeTimeline->size());
+    }
+
+    // Vuelve a la línea de tiempo generada a partir de las fases
+    void useTimelineFromPhases() {
+        buildTimelineFromPhases();
+        requestTimelineSave();
+    }
+
+    // Al reanudar se reescribe la salida del instante actual
+    void setOutputSuspended(bool suspended) {
+        outputSuspended = suspended;
+        lastSegment = NO_SEGMENT;
+    }
+
+    const Timeline& getTimeline() const {
+        return *activeTimeline;
     }
 
     void applyPhase(uint8_t phase) {
-        if (phase >= 5) return;
+        if (phase >= NUM_PHASES) return;
         
-        state.currentPhase = phase;
+        state.zones[zone].currentPhase = phase;
         
-        for (int i = 0; i < 2; i++) {
+        for (int i = 0; i < NUM_RGB; i++) {
+            output.rgb[i][0] = phases()[phase].rgb[i].r << 8;
+            output.rgb[i][1] = phases()[phase].rgb[i].g << 8;
+            output.rgb[i][2] = phases()[phase].rgb[i].b << 8;
+            if (!ownsRgb(i)) continue;
             rgbController.setRGBColor(i, 
-                                    phases[phase].rgb[i].r,
-                                    phases[phase].rgb[i].g,
-                                    phases[phase].rgb[i].b);
+                                    phases()[phase].rgb[i].r,
+                                    phases()[phase].rgb[i].g,
+                                    phases()[phase].rgb[i].b);
         }
         
-        for (int i = 0; i < 5; i++) {
-            rgbController.setAuxiliary(i, phases[phase].auxiliary[i]);
+        for (int i = 0; i < NUM_AUX; i++) {
+            output.auxiliary[i] = phases()[phase].auxiliary[i] << 8;
+            if (ownsAux(i)) rgbController.setAuxiliary(i, phases()[phase].auxiliary[i]);
         }
         
-        Serial.printf("Fase %d aplicada\n", phase);
+        LOG_INFO("Zona %u: Fase %d aplicada", zone + 1, phase);
     }
 
     void startTransition(uint8_t from, uint8_t to, unsigned long duration) {
-        if (from >= 5 || to >= 5) return;
+        if (from >= NUM_PHASES || to >= NUM_PHASES) return;
         
         fromPhase = from;
         toPhase = to;
         transitionDuration = duration;
         transitionStartTime = millis();
         inTransition = true;
+        scheduler.schedule(transitionEvent, transitionStartTime + duration);
         
-        Serial.printf("Iniciando transición de fase %d a fase %d\n", from, to);
+        LOG_INFO("Zona %u: Iniciando transición de fase %d a fase %d", zone + 1, from, to);
     }
 
-    // Método de actualización principal
+    // Método de actualización por frame: solo la salida de los fundidos;
+    // lo demás llega por el planificador
     void update() {
-        static unsigned long lastDebug = 0;
         unsigned long currentTime = millis();
 
-        // Debug cada segundo
-        if (currentTime - lastDebug >= 1000) {
-            Serial.printf("Estado: Sequence=%d, Transition=%d, Phase=%d, Time=%lu\n",
-                         sequenceRunning, inTransition, currentPhaseIndex,
-                         (currentTime - phaseStartTime));
-            lastDebug = currentTime;
-        }
-
-        // Manejo de la secuencia
-        if (sequenceRunning) {
-            if (currentTime - phaseStartTime >= phases[currentPhaseIndex].duration) {
-                uint8_t previousPhase = currentPhaseIndex;
-                currentPhaseIndex++;
-                if (currentPhaseIndex > LAST_SEQUENCE_PHASE) {
-                    currentPhaseIndex = FIRST_SEQUENCE_PHASE;
-                }
-                phaseStartTime = currentTime;
-                startTransition(previousPhase, currentPhaseIndex, 5000);
-            }
+        if (outputSuspended) return;
+
+        // Manejo de la secuencia: una transición manual tiene prioridad
+        if (sequenceRunning && !inTransition) {
+            applySample(activeTimeline->sample(sequenceTime(currentTime)));
         }
 
         // Manejo de transiciones
         if (inTransition) {
+            // El final lo aplica transitionEvent; hasta entonces se mantiene
             unsigned long elapsedTime = currentTime - transitionStartTime;
+            if (elapsedTime > transitionDuration) elapsedTime = transitionDuration;
             
-            if (elapsedTime >= transitionDuration) {
-                applyPhase(toPhase);
-                inTransition = false;
-                Serial.println("Transición completada");
-                return;
-            }
-            
-            float progress = (float)elapsedTime / transitionDuration;
+            // Una sola división por frame; el resto es punto fijo
+            const PhaseConfig& from = phases()[fromPhase];
+            const PhaseConfig& to = phases()[toPhase];
+            uint32_t progress = transitionDuration > 0 ? ((uint64_t)elapsedTime << 16) / transitionDuration : 65536;
+            progress = Easing::apply(from.easing, progress);
             
-            for (int i = 0; i < 2; i++) {
-                uint8_t r = interpolate(phases[fromPhase].rgb[i].r, phases[toPhase].rgb[i].r, progress);
-                uint8_t g = interpolate(phases[fromPhase].rgb[i].g, phases[toPhase].rgb[i].g, progress);
-                uint8_t b = interpolate(phases[fromPhase].rgb[i].b, phases[toPhase].rgb[i].b, progress);
-                rgbController.setRGBColor(i, r, g, b);
+            Levels levels;
+            for (int i = 0; i < NUM_RGB; i++) {
+                levels.rgb[i][0] = interpolate(from.rgb[i].r, to.rgb[i].r, progress);
+                levels.rgb[i][1] = interpolate(from.rgb[i].g, to.rgb[i].g, progress);
+                levels.rgb[i][2] = interpolate(from.rgb[i].b, to.rgb[i].b, progress);
             }
             
-            for (int i = 0; i < 5; i++) {
-                uint8_t value = interpolate(phases[fromPhase].auxiliary[i], 
-                                          phases[toPhase].auxiliary[i], 
-                                          progress);
-                rgbController.setAuxiliary(i, value);
+            for (int i = 0; i < NUM_AUX; i++) {
+                levels.auxiliary[i] = interpolate(from.auxiliary[i], to.auxiliary[i], progress);
             }
+            writeLevels(levels, TRANSITION_FADE, progress, true);
         }
     }
 
-    void saveToSPIFFS() {
-    File file = SPIFFS.open("/phases.cfg", "w");
-    if (!file) {
-        Serial.println("Error abriendo archivo para escritura");
-        return;
+    // Programa un guardado tras el periodo de calma de ConfigStore
+    void requestSave() {
+        unsigned long now = millis();
+        store.requestSave(now);
+        scheduler.schedule(saveEvent, now + ConfigStore::QUIET_PERIOD_MS);
     }
-    
-    file.write((uint8_t*)phases, sizeof(phases));
-    file.close();
-    Serial.println("Configuración guardada");
-}
-
-void loadFromSPIFFS() {
-    if (!SPIFFS.exists("/phases.cfg")) {
-        Serial.println("No existe archivo de configuración, cargando valores por defecto");
-        loadDefaultPhases();
-        return;
+
+    void requestTimelineSave() {
+        unsigned long now = millis();
+        timelineStore.requestSave(now);
+        scheduler.schedule(timelineSaveEvent, now + ConfigStore::QUIET_PERIOD_MS);
     }
-    
-    File file = SPIFFS.open("/phases.cfg", "r");
-    if (!file) {
-        Serial.println("Error abriendo archivo para lectura");
-        return;
+
+    void saveTimeline() {
+        if (!timelineStore.save(activeTimeline->raw(), activeTimeline->rawSize())) {
+            LOG_ERROR("Zona %u: Error guardando la linea de tiempo", zone + 1);
+            return;
+        }
+        LOG_INFO("Zona %u: Linea de tiempo guardada", zone + 1);
     }
-    
-    file.read((uint8_t*)phases, sizeof(phases));
-    file.close();
-    Serial.println("Configuración cargada");
+
+    // Guardado inmediato (también de las fases por defecto, si no hay otras)
+    void saveToSPIFFS() {
+        if (!store.save((const uint8_t*)phases(), sizeof(phaseTables[0]))) {
+            LOG_ERROR("Zona %u: Error guardando la configuración", zone + 1);
+            return;
+        }
+        LOG_INFO("Zona %u: Configuración guardada", zone + 1);
+    }
+
+    void loadFromSPIFFS() {
+        // La versión 0 era phases[] en crudo, sin cabecera; la 0 y la 1 no
+        // tenían curva
+        PhaseConfig* table = spareTable();
+        ConfigStore::LoadResult result = store.load((uint8_t*)table, sizeof(phaseTables[0]), sizeof(phaseTables[0]),
+                                                    CONFIG_VERSION_NO_EASING);
+        switch (result) {
+            case ConfigStore::LOAD_OK:
+                LOG_INFO("Zona %u: Configuración cargada", zone + 1);
+                break;
+            case ConfigStore::LOAD_MIGRATED:
+                LOG_WARN("Zona %u: Configuración antigua cargada, se reescribe en el formato actual", zone + 1);
+                break;
+            case ConfigStore::LOAD_MISSING:
+                LOG_INFO("Zona %u: No existe archivo de configuración, cargando valores por defecto", zone + 1);
+                loadDefaultPhases();
+                break;
+            case ConfigStore::LOAD_INVALID:
+                LOG_WARN("Zona %u: Configuración corrupta o desconocida, cargando valores por defecto", zone + 1);
+                loadDefaultPhases();
+                break;
+        }
+
+        if (result == ConfigStore::LOAD_OK || result == ConfigStore::LOAD_MIGRATED) {
+            // Los formatos anteriores a las curvas guardaban relleno en ese
+            // byte: se fundían en lineal
+            for (int i = 0; i < NUM_PHASES; i++) {
+                if (result == ConfigStore::LOAD_MIGRATED || table[i].easing >= Easing::CURVE_COUNT) {
+                    table[i].easing = Easing::LINEAR;
+                }
+            }
+            publishPhases(table);
+            if (result == ConfigStore::LOAD_MIGRATED) {
+                saveToSPIFFS();
+            }
+        }
+
+        // Línea de tiempo: si no hay una válida se genera a partir de las fases
+        size_t loaded = 0;
+        if (timelineStore.loadVariable(stagingTimeline->raw(), Timeline::maxRawSize(), loaded) == ConfigStore::LOAD_OK &&
+            stagingTimeline->validateRaw(loaded)) {
+            swapTimelines();
+            LOG_INFO("Zona %u: Linea de tiempo cargada: %u keyframes", zone + 1, activeTimeline->size());
+        } else {
+            buildTimelineFromPhases();
+        }
     }
     
 };
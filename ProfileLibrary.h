@@ -0,0 +1,375 @@
+// ProfileLibrary.h
+#pragma once
+#include <SPIFFS.h>
+#include <FS.h>
+#include "Checksum.h"
+#include "PhaseController.h"
+#include "LightingEngine.h"
+#include "Scheduler.h"
+#include "Log.h"
+
+using fs::File;
+
+// Biblioteca de perfiles con nombre: juegos completos de fases guardados
+// juntos en /profiles.lib.
+//
+// El fichero lleva una cabecera, un índice de MAX_PROFILES entradas
+// (nombre y CRC32) y un hueco fijo por perfil. El índice se lee entero al
+// arrancar, así que listar no toca el fichero y abrir un perfil es un seek
+// directo a su hueco. Los cambios reescriben el fichero en un temporal y
+// lo renombran, como ConfigStore.
+//
+// Vive en la tarea de comunicaciones. El perfil en uso de cada zona y el
+// siguiente se guardan ya decodificados en cache[]; cambiar de perfil es
+// mandar a la tarea de iluminación un puntero a esa tabla (USE_PROFILE),
+// que la publica sin copiarla y funde hacia ella. Un hueco de la caché
+// solo se reutiliza cuando ninguna zona lo usa y no queda ningún cambio
+// de perfil en la cola.
+class ProfileLibrary {
+public:
+    static const uint8_t MAX_PROFILES = 8;
+    static const uint8_t NAME_SIZE = 16;            // Con el '\0'
+    static const uint32_t DEFAULT_FADE_MS = 3000;
+    static const uint8_t SCHEDULER_EVENTS = 1;
+
+    enum Result {
+        OK,
+        NOT_FOUND,      // Hueco vacío
+        BUSY,           // Caché o cola ocupadas; reintentar más tarde
+        FAILED          // Error de SPIFFS o perfil corrupto
+    };
+
+private:
+    static const uint32_t FILE_MAGIC = 0x31465250;  // "PRF1"
+    static const uint16_t FILE_VERSION = 1;
+    static const uint8_t CACHE_SLOTS = NUM_ZONES + 1;  // Uno por zona y el siguiente
+    static const uint32_t RECORD_SIZE = sizeof(PhaseConfig) * NUM_PHASES;
+    static const uint32_t PRELOAD_RETRY_MS = 100;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint16_t maxProfiles;
+        uint16_t recordSize;
+        uint32_t indexCrc;
+    };
+
+    struct IndexEntry {
+        char name[NAME_SIZE];
+        uint32_t crc;                               // De las fases del perfil
+        uint8_t used;
+        uint8_t reserved[3];
+    };
+
+    static const uint32_t INDEX_OFFSET = sizeof(FileHeader);
+    static const uint32_t RECORDS_OFFSET = INDEX_OFFSET + sizeof(IndexEntry) * MAX_PROFILES;
+
+    struct CacheSlot {
+        PhaseConfig phases[NUM_PHASES];
+        uint8_t profile;                            // NO_PROFILE = sin perfil válido
+    };
+
+    const char* path = "/profiles.lib";
+    const char* tempPath = "/profiles.tmp";
+
+    LightingEngine& lightingEngine;
+    PhaseController (&zones)[NUM_ZONES];
+    Scheduler& scheduler;
+    Scheduler::Handle preloadEvent;
+
+    IndexEntry index[MAX_PROFILES];
+    CacheSlot cache[CACHE_SLOTS];
+    uint32_t postedSwitches = 0;                    // USE_PROFILE enviadas
+    uint8_t nextProfile = NO_PROFILE;               // El que se mantiene precargado
+
+    // Contadores: con la caché al día, cada cambio es un acierto
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t reads = 0;
+
+    static uint32_t recordOffset(uint8_t profile) {
+        return RECORDS_OFFSET + (uint32_t)profile * RECORD_SIZE;
+    }
+
+    void clearIndex() {
+        memset(index, 0, sizeof(index));
+    }
+
+    bool inUse(const CacheSlot& slot) const {
+        for (const PhaseController& zone : zones) {
+            if (zone.usesPhases(slot.phases)) return true;
+        }
+        return false;
+    }
+
+    CacheSlot* findCached(uint8_t profile) {
+        for (CacheSlot& slot : cache) {
+            if (slot.profile == profile) return &slot;
+        }
+        return nullptr;
+    }
+
+    // Hueco que se puede sobrescribir. Con cambios en cola una zona
+    // podría estar a punto de pasar a cualquiera: no hay ninguno libre.
+    CacheSlot* freeSlot() {
+        if (lightingEngine.getProfileSwitches() != postedSwitches) return nullptr;
+        CacheSlot* candidate = nullptr;
+        for (CacheSlot& slot : cache) {
+            if (inUse(slot)) continue;
+            if (slot.profile != nextProfile) return &slot;
+            candidate = &slot;          // El precargado, solo si no hay otro
+        }
+        return candidate;
+    }
+
+    bool readProfile(uint8_t profile, PhaseConfig* phases) {
+        File file = SPIFFS.open(path, "r");
+        if (!file) return false;
+        bool ok = file.seek(recordOffset(profile)) &&
+                  file.read((uint8_t*)phases, RECORD_SIZE) == RECORD_SIZE &&
+                  crc32((const uint8_t*)phases, RECORD_SIZE) == index[profile].crc;
+        file.close();
+        reads++;
+        return ok;
+    }
+
+    // Perfil decodificado en la caché, leyéndolo si hace falta
+    Result load(uint8_t profile, CacheSlot*& slot) {
+        if (profile >= MAX_PROFILES || !index[profile].used) return NOT_FOUND;
+        slot = findCached(profile);
+        if (slot != nullptr) return OK;
+
+        slot = freeSlot();
+        if (slot == nullptr) return BUSY;
+        slot->profile = NO_PROFILE;
+        if (!readProfile(profile, slot->phases)) {
+            LOG_ERROR("Perfil %u corrupto", profile + 1);
+            return FAILED;
+        }
+        slot->profile = profile;
+        return OK;
+    }
+
+    // Reescribe el fichero con 'entries' como índice; el hueco 'profile'
+    // toma 'phases' (nullptr = se deja vacío) y los demás se copian
+    bool writeFile(const IndexEntry* entries, uint8_t profile, const PhaseConfig* phases) {
+        File previous = SPIFFS.open(path, "r");
+        File file = SPIFFS.open(tempPath, "w");
+        if (!file) {
+            if (previous) previous.close();
+            return false;
+        }
+
+        FileHeader header = {FILE_MAGIC, FILE_VERSION, sizeof(FileHeader), MAX_PROFILES, (uint16_t)RECORD_SIZE,
+                             crc32((const uint8_t*)entries, sizeof(index))};
+        bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  file.write((const uint8_t*)entries, sizeof(index)) == sizeof(index);
+
+        uint8_t record[RECORD_SIZE];
+        for (uint8_t i = 0; i < MAX_PROFILES && ok; i++) {
+            if (i == profile && phases != nullptr) {
+                memcpy(record, phases, RECORD_SIZE);
+            } else if (i == profile || !entries[i].used) {
+                memset(record, 0, RECORD_SIZE);
+            } else {
+                ok = previous && previous.seek(recordOffset(i)) &&
+                     previous.read(record, RECORD_SIZE) == RECORD_SIZE;
+            }
+            ok = ok && file.write(record, RECORD_SIZE) == RECORD_SIZE;
+        }
+        file.close();
+        if (previous) previous.close();
+        if (!ok) {
+            SPIFFS.remove(tempPath);
+            return false;
+        }
+
+        // SPIFFS no renombra sobre un fichero existente
+        if (SPIFFS.exists(path)) {
+            SPIFFS.remove(path);
+        }
+        return SPIFFS.rename(tempPath, path);
+    }
+
+    // Tras reescribir un perfil, su copia en caché ya no vale. Si una zona
+    // la usa sigue con ella hasta el próximo cambio.
+    void forgetCached(uint8_t profile) {
+        CacheSlot* slot = findCached(profile);
+        if (slot != nullptr) slot->profile = NO_PROFILE;
+    }
+
+    // Siguiente perfil guardado después de 'profile', en orden circular
+    uint8_t followingProfile(uint8_t profile) const {
+        for (uint8_t step = 1; step <= MAX_PROFILES; step++) {
+            uint8_t candidate = (profile + step) % MAX_PROFILES;
+            if (index[candidate].used && candidate != profile) return candidate;
+        }
+        return NO_PROFILE;
+    }
+
+    void preload() {
+        if (nextProfile == NO_PROFILE) return;
+        CacheSlot* slot;
+        if (load(nextProfile, slot) == BUSY) {
+            // La tarea de iluminación aún no ha soltado la tabla anterior
+            scheduler.schedule(preloadEvent, millis() + PRELOAD_RETRY_MS);
+        }
+    }
+
+    static void preloadCallback(void* self) {
+        static_cast<ProfileLibrary*>(self)->preload();
+    }
+
+public:
+    ProfileLibrary(LightingEngine& lighting, PhaseController (&phaseZones)[NUM_ZONES], Scheduler& taskScheduler)
+        : lightingEngine(lighting), zones(phaseZones), scheduler(taskScheduler) {
+        preloadEvent = scheduler.add(preloadCallback, this);
+        if (preloadEvent == Scheduler::INVALID_HANDLE) {
+            LOG_ERROR("Perfiles: planificador lleno, sin precarga");
+        }
+        clearIndex();
+        for (CacheSlot& slot : cache) {
+            slot.profile = NO_PROFILE;
+        }
+    }
+
+    // Lee la cabecera y el índice; sin fichero válido la biblioteca está vacía
+    void begin() {
+        File file = SPIFFS.open(path, "r");
+        if (!file) {
+            LOG_INFO("Perfiles: biblioteca vacia");
+            return;
+        }
+        FileHeader header;
+        bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  header.magic == FILE_MAGIC &&
+                  header.version == FILE_VERSION &&
+                  header.headerSize == sizeof(FileHeader) &&
+                  header.maxProfiles == MAX_PROFILES &&
+                  header.recordSize == RECORD_SIZE &&
+                  file.read((uint8_t*)index, sizeof(index)) == sizeof(index) &&
+                  crc32((const uint8_t*)index, sizeof(index)) == header.indexCrc;
+        file.close();
+        if (!ok) {
+            clearIndex();
+            LOG_WARN("Perfiles: indice corrupto o de otra version, biblioteca vacia");
+            return;
+        }
+        LOG_INFO("Perfiles: %u guardados", count());
+    }
+
+    uint8_t count() const {
+        uint8_t used = 0;
+        for (const IndexEntry& entry : index) {
+            if (entry.used) used++;
+        }
+        return used;
+    }
+
+    bool isUsed(uint8_t profile) const {
+        return profile < MAX_PROFILES && index[profile].used;
+    }
+
+    const char* name(uint8_t profile) const {
+        return isUsed(profile) ? index[profile].name : "";
+    }
+
+    // Guarda las fases en uso de la zona 'zone' como perfil 'profile'
+    Result save(uint8_t profile, const char* profileName, uint8_t zone) {
+        if (profile >= MAX_PROFILES || zone >= NUM_ZONES) return NOT_FOUND;
+        // Copia propia: la tabla publicada puede reutilizarse para otro
+        // cambio de fases mientras se escribe el fichero
+        PhaseController::PhaseTable phases;
+        zones[zone].readPhases(phases);
+        IndexEntry entries[MAX_PROFILES];
+        memcpy(entries, index, sizeof(index));
+        IndexEntry& entry = entries[profile];
+        memset(&entry, 0, sizeof(entry));
+        strncpy(entry.name, profileName, NAME_SIZE - 1);
+        entry.crc = crc32((const uint8_t*)phases, RECORD_SIZE);
+        entry.used = 1;
+
+        if (!writeFile(entries, profile, phases)) {
+            LOG_ERROR("Perfiles: error guardando el perfil %u", profile + 1);
+            return FAILED;
+        }
+        memcpy(index, entries, sizeof(index));
+        forgetCached(profile);
+        LOG_INFO("Perfil %u guardado", profile + 1);
+        return OK;
+    }
+
+    Result remove(uint8_t profile) {
+        if (!isUsed(profile)) return NOT_FOUND;
+        IndexEntry entries[MAX_PROFILES];
+        memcpy(entries, index, sizeof(index));
+        memset(&entries[profile], 0, sizeof(IndexEntry));
+
+        if (!writeFile(entries, profile, nullptr)) {
+            LOG_ERROR("Perfiles: error borrando el perfil %u", profile + 1);
+            return FAILED;
+        }
+        memcpy(index, entries, sizeof(index));
+        forgetCached(profile);
+        if (nextProfile == profile) nextProfile = NO_PROFILE;
+        LOG_INFO("Perfil %u borrado", profile + 1);
+        return OK;
+    }
+
+    // Cambia a 'profile' las zonas elegidas (la última SELECT_ZONE en la
+    // cola). Con el perfil en caché no se toca el fichero; después se
+    // precarga el siguiente.
+    Result select(uint8_t profile, uint32_t fade) {
+        if (!lightingEngine.canPost(1)) return BUSY;
+        bool cached = findCached(profile) != nullptr;
+        CacheSlot* slot;
+        Result result = load(profile, slot);
+        if (result != OK) return result;
+        if (cached) hits++; else misses++;
+
+        LightingCommand command = LightingCommand::make(LightingCommand::USE_PROFILE);
+        command.profile = slot->phases;
+        command.phase = profile;
+        command.duration = fade;
+        if (!lightingEngine.post(command)) return BUSY;
+        postedSwitches++;
+
+        if (nextProfile == NO_PROFILE || nextProfile == profile) {
+            nextProfile = followingProfile(profile);
+        }
+        scheduler.schedule(preloadEvent, millis() + PRELOAD_RETRY_MS);
+        return OK;
+    }
+
+    // Perfil que se mantiene decodificado para el próximo cambio
+    Result setNext(uint8_t profile) {
+        if (!isUsed(profile)) return NOT_FOUND;
+        nextProfile = profile;
+        scheduler.schedule(preloadEvent, millis());
+        return OK;
+    }
+
+    uint8_t getNext() const {
+        return nextProfile;
+    }
+
+    bool isCached(uint8_t profile) const {
+        for (const CacheSlot& slot : cache) {
+            if (slot.profile == profile) return true;
+        }
+        return false;
+    }
+
+    uint32_t getHits() const {
+        return hits;
+    }
+
+    uint32_t getMisses() const {
+        return misses;
+    }
+
+    uint32_t getReads() const {
+        return reads;
+    }
+};
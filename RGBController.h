@@ -1,108 +1,199 @@
 // RGBController.h
 #pragma once
-#include <Adafruit_PWMServoDriver.h>
 #include "SystemState.h"
+#include "FadeEngine.h"
+#include "PWMOutput.h"
+#include "ChannelMap.h"
+#include "GammaTable.h"
 
 class RGBController {
 private:
-    Adafruit_PWMServoDriver& pwm;
+    static_assert(NUM_RGB + NUM_AUX <= FadeEngine::MAX_FADES, "faltan ranuras de fundido");
+    static_assert(NUM_RGB * 3 + NUM_AUX <= ChannelMap::LOGICAL_CHANNELS, "faltan canales lógicos");
+
+    PWMOutput& output;
+    ChannelMap& channels;
     SystemState& state;
+    FadeEngine fades;
+
+    // Canales lógicos; ChannelMap los reparte entre las placas
+    static const uint8_t RGB_BASE_CHANNEL = ChannelMap::RGB_BASE;   // 3 por tira
+    static const uint8_t AUX_BASE_CHANNEL = NUM_RGB * 3;
 
-    // Constantes para los canales PWM
-    static const int RGB1_BASE_CHANNEL = 0;  // Canales 0, 1, 2 para RGB1
-    static const int RGB2_BASE_CHANNEL = 3;  // Canales 3, 4, 5 para RGB2
-    static const int AUX_BASE_CHANNEL = 6;   // Canales 6-10 para auxiliares
+    // Ranuras del motor de fundidos
+    static const uint8_t FADE_SLOT_RGB = 0;       // Una por tira RGB
+    static const uint8_t FADE_SLOT_AUX = NUM_RGB;  // Una por auxiliar
     
     // Función auxiliar para convertir valores de 8 bits a 12 bits
+    // con corrección perceptual (tabla en flash, sin divisiones)
     uint16_t convert8to12Bits(uint8_t value) {
-        return map(value, 0, 255, 0, 4095);
+        return GammaTable::to12Bits(value);
     }
 
-public:
-    RGBController(Adafruit_PWMServoDriver& pwmDriver, SystemState& systemState)
-        : pwm(pwmDriver), state(systemState) {}
-
-    void begin() {
-        pwm.begin();
-        pwm.setPWMFreq(1000);  // Frecuencia PWM para un control suave
-        
-        // Inicialmente apagamos todos los canales
-        for (int i = 0; i < 11; i++) {  // 6 canales RGB + 5 auxiliares
-            pwm.setPWM(i, 0, 0);
+    // Escribe un canal lógico en todos sus canales físicos
+    void setLogical(uint8_t logical, uint16_t value) {
+        for (uint8_t p = channels.firstPhysical(logical); p != ChannelMap::NONE;
+             p = channels.nextPhysical(p)) {
+            output.set(p, value);
         }
     }
 
-    // Establece un color RGB completo para un canal específico
-    void setRGBColor(uint8_t channel, uint8_t r, uint8_t g, uint8_t b) {
-        if (channel >= 2) return;  // Solo tenemos 2 canales RGB
-        
+    // Escritura directa, usada tanto por los setters como por los fundidos
+    void writeRGB(uint8_t channel, uint8_t r, uint8_t g, uint8_t b) {
         // Actualizamos el estado
         state.rgb[channel].r = r;
         state.rgb[channel].g = g;
         state.rgb[channel].b = b;
         
-        // Calculamos el canal base (0 para RGB1, 3 para RGB2)
-        int baseChannel = (channel == 0) ? RGB1_BASE_CHANNEL : RGB2_BASE_CHANNEL;
+        // Calculamos el canal base (0 para RGB1, 3 para RGB2...)
+        uint8_t baseChannel = RGB_BASE_CHANNEL + channel * 3;
         
-        // Actualizamos los valores PWM
-        pwm.setPWM(baseChannel, 0, convert8to12Bits(r));
-        pwm.setPWM(baseChannel + 1, 0, convert8to12Bits(g));
-        pwm.setPWM(baseChannel + 2, 0, convert8to12Bits(b));
+        // Actualizamos los valores PWM (se envían en el próximo flush)
+        setLogical(baseChannel, convert8to12Bits(r));
+        setLogical(baseChannel + 1, convert8to12Bits(g));
+        setLogical(baseChannel + 2, convert8to12Bits(b));
     }
 
-    // Establece el valor para un canal auxiliar
-    void setAuxiliary(uint8_t auxChannel, uint8_t value) {
-        if (auxChannel >= 5) return;  // Solo tenemos 5 auxiliares
-        
+    void writeAuxiliary(uint8_t auxChannel, uint8_t value) {
         // Actualizamos el estado
         state.auxiliary[auxChannel] = value;
         
-        // Actualizamos el valor PWM
-        pwm.setPWM(AUX_BASE_CHANNEL + auxChannel, 0, convert8to12Bits(value));
+        // Actualizamos el valor PWM (se envía en el próximo flush)
+        setLogical(AUX_BASE_CHANNEL + auxChannel, convert8to12Bits(value));
     }
 
-    // Función para hacer un fundido suave entre dos colores
-    void fadeToColor(uint8_t channel, uint8_t targetR, uint8_t targetG, uint8_t targetB, uint16_t duration) {
-        uint8_t startR = state.rgb[channel].r;
-        uint8_t startG = state.rgb[channel].g;
-        uint8_t startB = state.rgb[channel].b;
+public:
+    RGBController(PWMOutput& pwmOutput, ChannelMap& channelMap, SystemState& systemState)
+        : output(pwmOutput), channels(channelMap), state(systemState) {}
+
+    // Configura las placas y envía todos los canales: lo restaurado con
+    // restoreLevels() o, si no, todo apagado
+    void begin() {
+        output.begin(1000);  // Frecuencia PWM para un control suave
+        output.invalidate();
+        output.flush();
+    }
+
+    // Niveles de arranque, uno por canal lógico (RGB y luego auxiliares);
+    // llamar antes de begin() para que salgan en el primer envío
+    void restoreLevels(const uint8_t* levels) {
+        for (uint8_t i = 0; i < NUM_RGB; i++) {
+            writeRGB(i, levels[i * 3], levels[i * 3 + 1], levels[i * 3 + 2]);
+        }
+        for (uint8_t i = 0; i < NUM_AUX; i++) {
+            writeAuxiliary(i, levels[NUM_RGB * 3 + i]);
+        }
+    }
+
+    // Establece un color RGB completo para un canal específico.
+    // Un valor fijado a mano cancela el fundido que hubiera en ese canal.
+    void setRGBColor(uint8_t channel, uint8_t r, uint8_t g, uint8_t b) {
+        if (channel >= NUM_RGB) return;
         
-        unsigned long startTime = millis();
-        unsigned long elapsedTime;
-        float progress;
+        fades.cancel(FADE_SLOT_RGB + channel);
+        writeRGB(channel, r, g, b);
+    }
+
+    // Establece el valor para un canal auxiliar
+    void setAuxiliary(uint8_t auxChannel, uint8_t value) {
+        if (auxChannel >= NUM_AUX) return;
         
-        do {
-            elapsedTime = millis() - startTime;
-            progress = (float)elapsedTime / duration;
-            if (progress > 1.0f) progress = 1.0f;
-            
-            uint8_t currentR = startR + (targetR - startR) * progress;
-            uint8_t currentG = startG + (targetG - startG) * progress;
-            uint8_t currentB = startB + (targetB - startB) * progress;
-            
-            setRGBColor(channel, currentR, currentG, currentB);
-            delay(5);  // Pequeña pausa para suavizar la transición
-            
-        } while (progress < 1.0f);
-    }
-
-    // Función para hacer un fundido suave en un auxiliar
+        fades.cancel(FADE_SLOT_AUX + auxChannel);
+        writeAuxiliary(auxChannel, value);
+    }
+
+    // Variantes con niveles 8.8 usadas por las transiciones de fase:
+    // la parte fraccionaria llega hasta la tabla gamma y se aprovechan
+    // los 4096 pasos del PCA9685 en lugar de 256 valores estirados
+    void setRGBLevels(uint8_t channel, uint16_t r, uint16_t g, uint16_t b) {
+        if (channel >= NUM_RGB) return;
+
+        fades.cancel(FADE_SLOT_RGB + channel);
+        state.rgb[channel].r = GammaTable::levelTo8Bits(r);
+        state.rgb[channel].g = GammaTable::levelTo8Bits(g);
+        state.rgb[channel].b = GammaTable::levelTo8Bits(b);
+
+        uint8_t baseChannel = RGB_BASE_CHANNEL + channel * 3;
+        setLogical(baseChannel, GammaTable::levelTo12Bits(r));
+        setLogical(baseChannel + 1, GammaTable::levelTo12Bits(g));
+        setLogical(baseChannel + 2, GammaTable::levelTo12Bits(b));
+    }
+
+    void setAuxiliaryLevel(uint8_t auxChannel, uint16_t level) {
+        if (auxChannel >= NUM_AUX) return;
+
+        fades.cancel(FADE_SLOT_AUX + auxChannel);
+        state.auxiliary[auxChannel] = GammaTable::levelTo8Bits(level);
+        setLogical(AUX_BASE_CHANNEL + auxChannel, GammaTable::levelTo12Bits(level));
+    }
+
+    // Inicia un fundido no bloqueante hacia un color; avanza en update()
+    void fadeToColor(uint8_t channel, uint8_t targetR, uint8_t targetG, uint8_t targetB, uint16_t duration) {
+        if (channel >= NUM_RGB) return;
+
+        const uint8_t from[3] = {state.rgb[channel].r, state.rgb[channel].g, state.rgb[channel].b};
+        const uint8_t to[3] = {targetR, targetG, targetB};
+        fades.start(FADE_SLOT_RGB + channel, from, to, 3, duration, millis());
+    }
+
+    // Inicia un fundido no bloqueante en un auxiliar; avanza en update()
     void fadeAuxiliary(uint8_t auxChannel, uint8_t targetValue, uint16_t duration) {
-        uint8_t startValue = state.auxiliary[auxChannel];
-        
-        unsigned long startTime = millis();
-        unsigned long elapsedTime;
-        float progress;
-        
-        do {
-            elapsedTime = millis() - startTime;
-            progress = (float)elapsedTime / duration;
-            if (progress > 1.0f) progress = 1.0f;
-            
-            uint8_t currentValue = startValue + (targetValue - startValue) * progress;
-            setAuxiliary(auxChannel, currentValue);
-            delay(5);
-            
-        } while (progress < 1.0f);
+        if (auxChannel >= NUM_AUX) return;
+
+        const uint8_t from = state.auxiliary[auxChannel];
+        fades.start(FADE_SLOT_AUX + auxChannel, &from, &targetValue, 1, duration, millis());
+    }
+
+    // Cancelan un fundido en curso dejando el valor en el que esté
+    void cancelFade(uint8_t channel) {
+        if (channel >= NUM_RGB) return;
+        fades.cancel(FADE_SLOT_RGB + channel);
+    }
+
+    void cancelAuxiliaryFade(uint8_t auxChannel) {
+        if (auxChannel >= NUM_AUX) return;
+        fades.cancel(FADE_SLOT_AUX + auxChannel);
+    }
+
+    bool isFading() const {
+        return fades.isAnyActive();
+    }
+
+    // Envía a los PCA9685 los canales que hayan cambiado
+    void flush() {
+        output.flush();
+    }
+
+    const PWMOutput::Stats& getOutputStats() const {
+        return output.getStats();
+    }
+
+    const PWMOutput& getOutput() const {
+        return output;
+    }
+
+    const ChannelMap& getChannelMap() const {
+        return channels;
+    }
+
+    // Avanza un paso todos los fundidos activos y envía la salida del frame.
+    // Llamar en cada loop(), después de PhaseController::update()
+    void update() {
+        unsigned long now = millis();
+        uint8_t values[FadeEngine::MAX_COMPONENTS];
+
+        for (uint8_t i = 0; i < NUM_RGB; i++) {
+            if (fades.step(FADE_SLOT_RGB + i, now, values)) {
+                writeRGB(i, values[0], values[1], values[2]);
+            }
+        }
+
+        for (uint8_t i = 0; i < NUM_AUX; i++) {
+            if (fades.step(FADE_SLOT_AUX + i, now, values)) {
+                writeAuxiliary(i, values[0]);
+            }
+        }
+
+        output.flush();
     }
 };
@@ -0,0 +1,47 @@
+// RelayOutput.h
+#pragma once
+#include "SystemState.h"
+
+// Salidas de relé (activas a nivel alto). Las maneja la tarea de
+// iluminación desde los eventos de keyframe de PhaseController; el estado
+// se refleja en SystemState::relay para la pantalla.
+class RelayOutput {
+public:
+    static const uint8_t COUNT = 2;
+
+private:
+    SystemState& state;
+    const uint8_t pins[COUNT];
+
+public:
+    RelayOutput(SystemState& systemState, uint8_t pin1, uint8_t pin2)
+        : state(systemState), pins{pin1, pin2} {}
+
+    void begin() {
+        for (uint8_t i = 0; i < COUNT; i++) {
+            pinMode(pins[i], OUTPUT);
+            digitalWrite(pins[i], LOW);
+            state.relay[i] = false;
+        }
+    }
+
+    // Bit i = relé i; solo se tocan los pines que cambian y, de ellos, los
+    // de 'owned' (los relés de la zona que escribe)
+    void set(uint8_t mask, uint8_t owned = 0xFF) {
+        for (uint8_t i = 0; i < COUNT; i++) {
+            if (!(owned & (1 << i))) continue;
+            bool on = mask & (1 << i);
+            if (on == state.relay[i]) continue;
+            state.relay[i] = on;
+            digitalWrite(pins[i], on ? HIGH : LOW);
+        }
+    }
+
+    uint8_t get() const {
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < COUNT; i++) {
+            if (state.relay[i]) mask |= 1 << i;
+        }
+        return mask;
+    }
+};
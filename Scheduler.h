@@ -0,0 +1,152 @@
+// Scheduler.h
+#pragma once
+
+// Planificador de eventos por tiempo para una tarea: montículo mínimo de
+// vencimientos sobre un conjunto fijo de eventos registrados al arrancar.
+//
+// Cada tarea tiene el suyo y lo ejecuta desde su bucle con runDue(); así
+// solo se hace el trabajo que vence y nextDue() dice cuánto falta para el
+// siguiente. Los instantes son ms de millis() y se comparan por diferencia
+// con signo, así que el desbordamiento de 49 días no afecta.
+class Scheduler {
+public:
+    typedef void (*Callback)(void* context);
+    typedef uint8_t Handle;
+
+    static const uint8_t MAX_EVENTS = 16;
+    static const Handle INVALID_HANDLE = 0xFF;
+    static const uint32_t NO_DEADLINE = 0xFFFFFFFF;
+
+private:
+    static const uint8_t NOT_QUEUED = 0xFF;
+
+    struct Event {
+        Callback callback;
+        void* context;
+        uint32_t due;
+        uint32_t period;        // 0 = una sola vez
+        uint8_t heapIndex;      // Posición en heap[] o NOT_QUEUED
+    };
+
+    Event events[MAX_EVENTS];
+    uint8_t eventCount = 0;
+    uint8_t heap[MAX_EVENTS];   // Índices de events[], el más próximo primero
+    uint8_t heapSize = 0;
+
+    static bool before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+    }
+
+    bool earlier(uint8_t i, uint8_t j) const {
+        return before(events[heap[i]].due, events[heap[j]].due);
+    }
+
+    void swapNodes(uint8_t i, uint8_t j) {
+        uint8_t tmp = heap[i];
+        heap[i] = heap[j];
+        heap[j] = tmp;
+        events[heap[i]].heapIndex = i;
+        events[heap[j]].heapIndex = j;
+    }
+
+    void siftUp(uint8_t i) {
+        while (i > 0) {
+            uint8_t parent = (i - 1) / 2;
+            if (!earlier(i, parent)) break;
+            swapNodes(i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(uint8_t i) {
+        for (;;) {
+            uint8_t left = 2 * i + 1;
+            uint8_t right = left + 1;
+            uint8_t smallest = i;
+            if (left < heapSize && earlier(left, smallest)) smallest = left;
+            if (right < heapSize && earlier(right, smallest)) smallest = right;
+            if (smallest == i) break;
+            swapNodes(i, smallest);
+            i = smallest;
+        }
+    }
+
+    void removeAt(uint8_t i) {
+        events[heap[i]].heapIndex = NOT_QUEUED;
+        heapSize--;
+        if (i == heapSize) return;
+        heap[i] = heap[heapSize];
+        events[heap[i]].heapIndex = i;
+        siftDown(i);
+        siftUp(i);
+    }
+
+public:
+    // Registra un evento (sin programar). Falla si no quedan huecos.
+    Handle add(Callback callback, void* context) {
+        if (eventCount >= MAX_EVENTS) return INVALID_HANDLE;
+        Event& event = events[eventCount];
+        event.callback = callback;
+        event.context = context;
+        event.due = 0;
+        event.period = 0;
+        event.heapIndex = NOT_QUEUED;
+        return eventCount++;
+    }
+
+    // Programa (o reprograma) un evento para 'due'; con 'period' se repite
+    void schedule(Handle handle, uint32_t due, uint32_t period = 0) {
+        if (handle >= eventCount) return;
+        Event& event = events[handle];
+        event.due = due;
+        event.period = period;
+        if (event.heapIndex == NOT_QUEUED) {
+            event.heapIndex = heapSize;
+            heap[heapSize++] = handle;
+            siftUp(event.heapIndex);
+        } else {
+            siftDown(event.heapIndex);
+            siftUp(event.heapIndex);
+        }
+    }
+
+    void cancel(Handle handle) {
+        if (handle >= eventCount || events[handle].heapIndex == NOT_QUEUED) return;
+        removeAt(events[handle].heapIndex);
+    }
+
+    bool isScheduled(Handle handle) const {
+        return handle < eventCount && events[handle].heapIndex != NOT_QUEUED;
+    }
+
+    // Ejecuta lo que haya vencido en 'now' y devuelve cuántos eventos.
+    // Un evento periódico atrasado no recupera los disparos perdidos.
+    uint8_t runDue(uint32_t now) {
+        uint8_t ran = 0;
+        while (heapSize > 0 && !before(now, events[heap[0]].due)) {
+            Handle handle = heap[0];
+            Event& event = events[handle];
+            if (event.period > 0) {
+                event.due += event.period;
+                if (before(event.due, now)) event.due = now + event.period;
+                siftDown(0);
+            } else {
+                removeAt(0);
+            }
+            event.callback(event.context);  // Puede volver a programarse
+            ran++;
+        }
+        return ran;
+    }
+
+    // ms hasta el próximo vencimiento (0 si ya ha vencido)
+    uint32_t nextDue(uint32_t now) const {
+        if (heapSize == 0) return NO_DEADLINE;
+        uint32_t due = events[heap[0]].due;
+        return before(now, due) ? due - now : 0;
+    }
+
+    uint8_t pending() const {
+        return heapSize;
+    }
+};
@@ -0,0 +1,35 @@
+// SeqLock.h
+#pragma once
+#include <atomic>
+
+// Instantánea protegida por un contador de secuencia (seqlock).
+// Un único escritor publica copias completas; los lectores copian sin
+// bloquear al escritor y reintentan si la copia coincidió con una escritura.
+// T debe poder copiarse byte a byte (como SystemState).
+template <typename T>
+class SeqLock {
+private:
+    std::atomic<uint32_t> sequence{0};  // Impar = escritura en curso
+    T value;
+
+public:
+    // Solo desde el hilo escritor
+    void write(const T& newValue) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy((void*)&value, (const void*)&newValue, sizeof(T));
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Desde cualquier hilo
+    void read(T& out) const {
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            memcpy((void*)&out, (const void*)&value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+    }
+};
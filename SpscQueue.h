@@ -0,0 +1,49 @@
+// SpscQueue.h
+#pragma once
+#include <atomic>
+
+// Cola sin bloqueos de un solo productor y un solo consumidor.
+// El productor solo escribe 'head' y el consumidor solo escribe 'tail',
+// así que pueden estar en núcleos distintos sin mutex.
+template <typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "La capacidad debe ser potencia de 2");
+
+private:
+    T items[Capacity];
+    std::atomic<uint32_t> head{0};  // Próxima posición a escribir (productor)
+    std::atomic<uint32_t> tail{0};  // Próxima posición a leer (consumidor)
+
+public:
+    // Productor
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity) {
+            return false;  // Llena
+        }
+        items[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Productor: huecos libres garantizados (el consumidor solo los aumenta)
+    uint32_t freeSpace() const {
+        return Capacity - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+
+    // Consumidor
+    bool isEmpty() const {
+        return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+    }
+
+    // Consumidor
+    bool pop(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;  // Vacía
+        }
+        item = items[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
@@ -1,23 +1,41 @@
 // SystemState.h
 #pragma once
+#include "LightingConfig.h"
+
+// Valores de SystemState::audioMode
+static const uint8_t AUDIO_MODE_SCHEDULE = 0;   // Luz según fases / línea de tiempo
+static const uint8_t AUDIO_MODE_REACTIVE = 1;   // Luz según la música (AudioReactive)
+
+// SystemState::Zone::profile sin perfil de la biblioteca (o ya modificado)
+static const uint8_t NO_PROFILE = 0xFF;
 
 struct SystemState {
-    uint8_t currentPhase;
+    static_assert(NUM_RGB > 0 && NUM_AUX > 0, "hace falta al menos un canal de cada tipo");
+
+    struct Zone {
+        uint8_t currentPhase;       // Fase con nombre o 255 si el keyframe no tiene
+        uint16_t currentKeyframe;   // Keyframe activo de su línea de tiempo
+        uint16_t keyframeCount;
+        uint8_t profile;            // Perfil de ProfileLibrary en uso o NO_PROFILE
+    } zones[NUM_ZONES];
+    uint8_t selectedZone;       // Destino de las órdenes de fase: zona o ZONE_ALL
     struct {
         uint8_t r;
         uint8_t g;
         uint8_t b;
-    } rgb[2];
-    uint8_t auxiliary[5];
+    } rgb[NUM_RGB];
+    uint8_t auxiliary[NUM_AUX];
     bool relay[2];
-    uint8_t audioMode;
-    uint8_t currentTrack;
+    uint8_t audioMode;          // AUDIO_MODE_*: programa o reactivo a la música
     
-    SystemState() : currentPhase(0), audioMode(0), currentTrack(1) {
-        for(int i = 0; i < 2; i++) {
+    SystemState() : selectedZone(ZONE_ALL), audioMode(AUDIO_MODE_SCHEDULE) {
+        for (int z = 0; z < NUM_ZONES; z++) {
+            zones[z] = {0, 0, 0, NO_PROFILE};
+        }
+        for(int i = 0; i < NUM_RGB; i++) {
             rgb[i] = {0, 0, 0};
         }
-        for(int i = 0; i < 5; i++) {
+        for(int i = 0; i < NUM_AUX; i++) {
             auxiliary[i] = 0;
         }
         relay[0] = relay[1] = false;
@@ -0,0 +1,202 @@
+// Timeline.h
+#pragma once
+#include "LightingConfig.h"
+
+// Línea de tiempo de keyframes ordenados por instante dentro de un ciclo
+// (por ejemplo un día). Cada keyframe fija la salida a partir de su instante,
+// y su 'crossFade' es la duración del fundido hacia el keyframe siguiente,
+// que empieza en el instante de ese siguiente keyframe (igual que una fase
+// con su transición a la siguiente fase) y dura como mucho su segmento.
+//
+// La búsqueda del segmento activo usa un cursor: avanzar al segmento
+// siguiente es O(1) y cualquier salto (reinicio del ciclo, cambio de hora)
+// se resuelve con una búsqueda binaria.
+class Timeline {
+public:
+    static const uint16_t MAX_KEYFRAMES = 256;
+    static const uint8_t NO_LABEL = 255;  // Keyframe sin fase con nombre
+
+    struct Keyframe {
+        uint32_t time;          // ms desde el inicio del ciclo
+        uint32_t crossFade;     // ms de fundido hacia el siguiente keyframe
+        uint8_t rgb[NUM_RGB][3];
+        uint8_t auxiliary[NUM_AUX];
+        uint8_t relays;         // Bit i = relé i
+        uint8_t label;          // Fase con nombre (0-4) o NO_LABEL
+        uint8_t easing;         // Easing::Curve del fundido hacia el siguiente
+        uint8_t reserved[2];    // Relleno explícito, a cero
+    };
+
+    // Resultado de evaluar la línea de tiempo en un instante
+    struct Sample {
+        uint16_t segment;       // Keyframe activo
+        uint16_t from;          // Keyframe de origen si hay fundido
+        uint32_t progressQ16;   // 0-65536; 65536 = mantener 'segment'
+        bool fading;
+    };
+
+private:
+    // Cabecera + keyframes contiguos: es exactamente lo que se guarda
+    struct Data {
+        uint32_t period;        // Duración del ciclo en ms
+        uint16_t count;
+        uint8_t fromPhases;     // 1 = generada a partir de las fases
+        uint8_t anchored;       // 1 = el instante 0 es la medianoche del reloj
+        Keyframe keyframes[MAX_KEYFRAMES];
+    };
+
+    Data data;
+    uint16_t cursor = 0;
+
+    static const size_t HEADER_SIZE = sizeof(Data) - sizeof(Keyframe) * MAX_KEYFRAMES;
+
+    // Mayor i con keyframes[i].time <= t, o count - 1 si t es anterior
+    // al primer keyframe (el segmento que viene del ciclo anterior)
+    uint16_t search(uint32_t t) const {
+        uint16_t low = 0;
+        uint16_t high = data.count;
+        while (low < high) {
+            uint16_t mid = (low + high) / 2;
+            if (data.keyframes[mid].time <= t) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low == 0 ? data.count - 1 : low - 1;
+    }
+
+    bool contains(uint16_t segment, uint32_t t) const {
+        if (segment >= data.count) return false;
+        if (t < data.keyframes[0].time) return segment == data.count - 1;
+        uint32_t end = segment + 1 < data.count ? data.keyframes[segment + 1].time : data.period;
+        return t >= data.keyframes[segment].time && t < end;
+    }
+
+public:
+    Timeline() {
+        clear(0);
+    }
+
+    void clear(uint32_t period) {
+        memset(&data, 0, HEADER_SIZE);
+        data.period = period;
+        cursor = 0;
+    }
+
+    uint16_t size() const { return data.count; }
+    uint32_t getPeriod() const { return data.period; }
+    bool isEmpty() const { return data.count == 0 || data.period == 0; }
+    bool isFromPhases() const { return data.fromPhases != 0; }
+    void setFromPhases(bool value) { data.fromPhases = value ? 1 : 0; }
+    bool isAnchored() const { return data.anchored != 0; }
+    void setAnchored(bool value) { data.anchored = value ? 1 : 0; }
+
+    const Keyframe& at(uint16_t index) const {
+        return data.keyframes[index];
+    }
+
+    // Inserta manteniendo el orden; un keyframe en el mismo instante
+    // sustituye al existente. Falla si no cabe o cae fuera del ciclo.
+    bool insert(const Keyframe& keyframe) {
+        if (keyframe.time >= data.period) return false;
+
+        uint16_t position = 0;
+        while (position < data.count && data.keyframes[position].time < keyframe.time) {
+            position++;
+        }
+
+        if (position < data.count && data.keyframes[position].time == keyframe.time) {
+            data.keyframes[position] = keyframe;
+        } else {
+            if (data.count >= MAX_KEYFRAMES) return false;
+            memmove(&data.keyframes[position + 1], &data.keyframes[position],
+                    (data.count - position) * sizeof(Keyframe));
+            data.keyframes[position] = keyframe;
+            data.count++;
+        }
+
+        memset(data.keyframes[position].reserved, 0, sizeof(keyframe.reserved));
+        cursor = 0;
+        return true;
+    }
+
+    // Segmento activo en el instante t (0 <= t < período)
+    uint16_t findSegment(uint32_t t) {
+        if (contains(cursor, t)) return cursor;
+
+        uint16_t next = cursor + 1 < data.count ? cursor + 1 : 0;
+        if (contains(next, t)) {
+            cursor = next;
+        } else {
+            cursor = search(t);
+        }
+        return cursor;
+    }
+
+    // ms desde t hasta el inicio del keyframe siguiente (un ciclo entero
+    // si solo hay uno)
+    uint32_t timeToNextKeyframe(uint32_t t) {
+        if (isEmpty()) return 0;
+        t %= data.period;
+        uint16_t segment = findSegment(t);
+        uint16_t next = segment + 1 < data.count ? segment + 1 : 0;
+        uint32_t start = data.keyframes[next].time;
+        return start > t ? start - t : start + data.period - t;
+    }
+
+    // ms que dura un segmento (un ciclo entero si solo hay un keyframe)
+    uint32_t segmentLength(uint16_t segment) const {
+        uint16_t next = segment + 1 < data.count ? segment + 1 : 0;
+        uint32_t start = data.keyframes[segment].time;
+        uint32_t end = data.keyframes[next].time;
+        return end > start ? end - start : end + data.period - start;
+    }
+
+    // Evalúa el instante t (se reduce al ciclo si hace falta)
+    Sample sample(uint32_t t) {
+        Sample result = {0, 0, 65536, false};
+        if (isEmpty()) return result;
+
+        t %= data.period;
+        uint16_t segment = findSegment(t);
+        uint16_t previous = segment == 0 ? data.count - 1 : segment - 1;
+        const Keyframe& current = data.keyframes[segment];
+
+        uint32_t elapsed = t >= current.time ? t - current.time
+                                              : t + data.period - current.time;
+        // Un fundido más largo que el segmento se acorta para llegar al
+        // destino antes del keyframe siguiente en lugar de quedar cortado
+        uint32_t fade = data.keyframes[previous].crossFade;
+        uint32_t length = segmentLength(segment);
+        if (fade > length) fade = length;
+
+        result.segment = segment;
+        result.from = previous;
+        if (data.count > 1 && elapsed < fade) {
+            result.progressQ16 = ((uint64_t)elapsed << 16) / fade;
+            result.fading = true;
+        }
+        return result;
+    }
+
+    // Acceso para guardar y cargar con ConfigStore
+    const uint8_t* raw() const { return (const uint8_t*)&data; }
+    uint8_t* raw() { return (uint8_t*)&data; }
+    size_t rawSize() const { return HEADER_SIZE + data.count * sizeof(Keyframe); }
+    static size_t maxRawSize() { return sizeof(Data); }
+
+    // Comprueba un bloque recién cargado en raw()
+    bool validateRaw(size_t loadedSize) {
+        if (loadedSize < HEADER_SIZE || data.count > MAX_KEYFRAMES ||
+            loadedSize != HEADER_SIZE + data.count * sizeof(Keyframe)) {
+            return false;
+        }
+        for (uint16_t i = 0; i < data.count; i++) {
+            if (data.keyframes[i].time >= data.period) return false;
+            if (i > 0 && data.keyframes[i].time <= data.keyframes[i - 1].time) return false;
+        }
+        cursor = 0;
+        return true;
+    }
+};
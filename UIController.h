@@ -2,81 +2,154 @@
 #include <TFT_eSPI.h>
 #include "SystemState.h"
 #include "PhaseController.h"
+#include "LoopStats.h"
+#include "AudioController.h"
 
 class UIController {
 private:
     TFT_eSPI& tft;
     SystemState& state;
-    PhaseController& phaseController;
+    PhaseController (&zones)[NUM_ZONES];
+    LoopStats& stats;
+    AudioController& audio;
     
     // Constantes para el layout
     static const int LINE_HEIGHT = 30;
     static const int VALUE_X = 100;
     static const int START_Y = 40;
 
+    // Campos de valores; cada uno recuerda el último texto dibujado
+    enum Field {
+        FIELD_PHASE,
+        FIELD_TIMES,
+        FIELD_RGB1,
+        FIELD_RGB2,
+        FIELD_AUX,
+        FIELD_AUDIO,
+        FIELD_COUNT
+    };
+
+    struct FieldCache {
+        char text[32];
+        int16_t width;   // Ancho en píxeles del texto dibujado
+    };
+
+    FieldCache fieldCache[FIELD_COUNT];
+
+    // Contadores de píxeles enviados por SPI (ventana de un segundo)
+    static const uint8_t BYTES_PER_PIXEL = 2;  // RGB565
+    uint32_t pixelsThisWindow = 0;
+    uint32_t pixelsPerSecond = 0;
+
     // Función auxiliar privada para limpiar áreas
     void clearTextArea(int x, int y, int width, int height) {
         tft.fillRect(x, y, width, height, TFT_BLACK);
+        pixelsThisWindow += (uint32_t)width * height;
+    }
+
+    // Olvida lo dibujado, p. ej. tras limpiar la pantalla completa
+    void invalidateFields() {
+        for (int i = 0; i < FIELD_COUNT; i++) {
+            fieldCache[i].text[0] = '\0';
+            fieldCache[i].width = 0;
+        }
     }
 
-    // Nueva implementación unificada de updateValues
+    // Redibuja un campo solo si su texto ha cambiado. El texto se pinta
+    // con fondo, así que solo hay que limpiar lo que sobre a la derecha
+    // si el nuevo es más corto que el anterior.
+    void drawField(Field field, const char* text, int x, int y,
+                   uint8_t textSize, uint16_t color) {
+        FieldCache& cache = fieldCache[field];
+        if (cache.text[0] != '\0' && strcmp(cache.text, text) == 0) {
+            return;
+        }
+
+        tft.setTextSize(textSize);
+        tft.setTextColor(color, TFT_BLACK);
+        int16_t width = tft.drawString(text, x, y);
+        int16_t height = tft.fontHeight();
+        pixelsThisWindow += (uint32_t)width * height;
+
+        if (width < cache.width) {
+            clearTextArea(x + width, y, cache.width - width, height);
+        }
+
+        stats.count(LoopStats::TFT_REDRAWS);
+        strncpy(cache.text, text, sizeof(cache.text) - 1);
+        cache.text[sizeof(cache.text) - 1] = '\0';
+        cache.width = width;
+    }
+
+    // Formatea cada campo en buffers de pila y redibuja solo los que cambian
     void updateValues() {
-        const char* phaseNames[] = {"Apagado", "Alba", "Dia", "Tarde", "Noche"};
-        
-        // 1. Actualización de fase y tiempos
-        clearTextArea(VALUE_X, START_Y, 200, LINE_HEIGHT);
-        tft.setTextColor(TFT_MAGENTA, TFT_BLACK);
-        tft.setTextSize(2);
-        tft.drawString(phaseNames[state.currentPhase], VALUE_X, START_Y);
-        
-        // Tiempos de la fase
-        const auto& currentPhase = phaseController.getPhaseConfig(state.currentPhase);
-        char timeStr[32];
-        sprintf(timeStr, "%d seg / %d seg", 
-                currentPhase.duration/1000,
-                currentPhase.crossFade/1000);
-        tft.setTextSize(1);
-        tft.drawString(timeStr, VALUE_X + 100, START_Y);
-
-        // 2. Valores RGB
-        char rgbStr[32];
-        tft.setTextSize(2);
+        static const char* const phaseNames[] = {"Apagado", "Alba", "Dia", "Tarde", "Noche"};
+        static_assert(sizeof(phaseNames) / sizeof(phaseNames[0]) == NUM_PHASES, "falta el nombre de alguna fase");
+        char text[32];
         
-        // RGB 1
-        clearTextArea(VALUE_X, START_Y + LINE_HEIGHT, 200, LINE_HEIGHT);
-        sprintf(rgbStr, "R:%3d G:%3d B:%3d", 
-                state.rgb[0].r, state.rgb[0].g, state.rgb[0].b);
-        tft.setTextColor(TFT_MAGENTA, TFT_BLACK);
-        tft.drawString(rgbStr, VALUE_X, START_Y + LINE_HEIGHT);
+        // 1. Fase de cada zona separadas por '/'; un keyframe sin fase con
+        // nombre se muestra como KF
+        int length = 0;
+        text[0] = '\0';
+        for (uint8_t i = 0; i < NUM_ZONES && length < (int)sizeof(text); i++) {
+            uint8_t phase = state.zones[i].currentPhase;
+            length += snprintf(text + length, sizeof(text) - length, i ? "/%s" : "%s",
+                               phase < NUM_PHASES ? phaseNames[phase] : "KF");
+        }
+        drawField(FIELD_PHASE, text, VALUE_X, START_Y, 2, TFT_MAGENTA);
+
+        // Tiempos de la zona elegida por Bluetooth (la primera si son todas)
+        uint8_t shown = state.selectedZone < NUM_ZONES ? state.selectedZone : 0;
+        const SystemState::Zone& zone = state.zones[shown];
+        if (zone.currentPhase < NUM_PHASES) {
+            PhaseController::PhaseTable phases;
+            zones[shown].readPhases(phases);
+            const PhaseConfig& currentPhase = phases[zone.currentPhase];
+            snprintf(text, sizeof(text), "Z%u %lu seg / %lu seg", shown + 1,
+                     currentPhase.duration / 1000,
+                     currentPhase.crossFade / 1000);
+        } else {
+            snprintf(text, sizeof(text), "Z%u %u / %u", shown + 1,
+                     zone.currentKeyframe + 1, zone.keyframeCount);
+        }
+        drawField(FIELD_TIMES, text, VALUE_X + 100, START_Y + 20, 1, TFT_MAGENTA);
+
+        // 2. Valores RGB (la pantalla tiene sitio para las dos primeras tiras)
+        snprintf(text, sizeof(text), "R:%3d G:%3d B:%3d", 
+                 state.rgb[0].r, state.rgb[0].g, state.rgb[0].b);
+        drawField(FIELD_RGB1, text, VALUE_X, START_Y + LINE_HEIGHT, 2, TFT_MAGENTA);
         
-        // RGB 2
-        clearTextArea(VALUE_X, START_Y + LINE_HEIGHT * 2, 200, LINE_HEIGHT);
-        sprintf(rgbStr, "R:%3d G:%3d B:%3d", 
-                state.rgb[1].r, state.rgb[1].g, state.rgb[1].b);
-        tft.drawString(rgbStr, VALUE_X, START_Y + LINE_HEIGHT * 2);
-
-        // 3. Auxiliares
-        clearTextArea(VALUE_X, START_Y + LINE_HEIGHT * 3, 200, LINE_HEIGHT);
-        String auxStatus = "";
-        for(int i = 0; i < 5; i++) {
-            auxStatus += (i > 0 ? " " : "") + String(state.auxiliary[i]);
+        if (NUM_RGB > 1) {
+            snprintf(text, sizeof(text), "R:%3d G:%3d B:%3d", 
+                     state.rgb[NUM_RGB - 1].r, state.rgb[NUM_RGB - 1].g, state.rgb[NUM_RGB - 1].b);
+            drawField(FIELD_RGB2, text, VALUE_X, START_Y + LINE_HEIGHT * 2, 2, TFT_MAGENTA);
         }
-        tft.drawString(auxStatus, VALUE_X, START_Y + LINE_HEIGHT * 3);
+
+        // 3. Auxiliares, separados por espacios
+        length = 0;
+        text[0] = '\0';
+        for (uint8_t i = 0; i < NUM_AUX && length < (int)sizeof(text); i++) {
+            length += snprintf(text + length, sizeof(text) - length, i ? " %d" : "%d", state.auxiliary[i]);
+        }
+        drawField(FIELD_AUX, text, VALUE_X, START_Y + LINE_HEIGHT * 3, 2, TFT_MAGENTA);
 
         // 4. Audio
-        clearTextArea(VALUE_X, START_Y + LINE_HEIGHT * 4, 200, LINE_HEIGHT);
-        char audioStr[32];
-        sprintf(audioStr, "Mode:%d Track:%d", 
-                state.audioMode, state.currentTrack);
-        tft.drawString(audioStr, VALUE_X, START_Y + LINE_HEIGHT * 4);
+        snprintf(text, sizeof(text), "Mode:%d Track:%d", 
+                 state.audioMode, audio.getCurrentTrack());
+        drawField(FIELD_AUDIO, text, VALUE_X, START_Y + LINE_HEIGHT * 4, 2, TFT_MAGENTA);
     }
 
 public:
-    UIController(TFT_eSPI& display, SystemState& systemState, PhaseController& phase)
+    UIController(TFT_eSPI& display, SystemState& systemState, PhaseController (&phaseZones)[NUM_ZONES], LoopStats& loopStats,
+                 AudioController& audioController)
         : tft(display)
         , state(systemState)
-        , phaseController(phase)
-    {}
+        , zones(phaseZones)
+        , stats(loopStats)
+        , audio(audioController)
+    {
+        invalidateFields();
+    }
 
     void begin() {
         tft.init();
@@ -85,8 +158,12 @@ public:
         drawMainInterface();
     }
 
+    // Dibujo completo; solo se usa al arrancar; después todo es parcial
     void drawMainInterface() {
         tft.fillScreen(TFT_BLACK);
+        pixelsThisWindow += (uint32_t)tft.width() * tft.height();
+        stats.count(LoopStats::TFT_REDRAWS);
+        invalidateFields();
         
         // Título
         tft.setTextSize(2);
@@ -106,21 +183,28 @@ public:
         updateValues();  // Actualizamos los valores iniciales
     }
 
+    // Refresco de la pantalla; el ritmo (UPDATE_INTERVAL_MS) lo marca el
+    // planificador de la tarea de comunicaciones
+    static const uint32_t UPDATE_INTERVAL_MS = 100;
+    static const uint32_t STATS_WINDOW_MS = 1000;
+
     void updateDisplay() {
-        static unsigned long lastUpdate = 0;
-        const unsigned long UPDATE_INTERVAL = 100;
-        
-        if (millis() - lastUpdate < UPDATE_INTERVAL) {
-            return;
-        }
-        lastUpdate = millis();
+        // Un cambio de fase solo cambia los campos de fase y tiempos
+        updateValues();
+    }
 
-        static uint8_t lastPhase = 255;
-        if (state.currentPhase != lastPhase) {
-            drawMainInterface();
-            lastPhase = state.currentPhase;
-        } else {
-            updateValues();
-        }
+    // Cierra la ventana de contadores; llamar cada STATS_WINDOW_MS
+    void closeStatsWindow() {
+        pixelsPerSecond = pixelsThisWindow;
+        pixelsThisWindow = 0;
+    }
+
+    // Carga de la pantalla en el último segundo completo
+    uint32_t getPixelsPerSecond() const {
+        return pixelsPerSecond;
+    }
+
+    uint32_t getSpiBytesPerSecond() const {
+        return pixelsPerSecond * BYTES_PER_PIXEL;
     }
 };
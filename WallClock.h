@@ -0,0 +1,38 @@
+// WallClock.h
+#pragma once
+
+// Hora del día mantenida con millis() a partir de la última puesta en hora
+// (por Bluetooth). No hay RTC: tras un reinicio el reloj queda sin ajustar
+// hasta que se vuelve a poner en hora.
+class WallClock {
+public:
+    static const uint32_t DAY_MS = 24UL * 60 * 60 * 1000;
+
+private:
+    bool valid = false;
+    uint32_t baseTimeOfDay = 0;     // ms del día en la puesta en hora
+    unsigned long baseMillis = 0;   // millis() en la puesta en hora
+
+public:
+    void set(uint32_t timeOfDayMs, unsigned long now) {
+        baseTimeOfDay = timeOfDayMs % DAY_MS;
+        baseMillis = now;
+        valid = true;
+    }
+
+    bool isSet() const {
+        return valid;
+    }
+
+    // ms desde medianoche. Los días completos se pasan a baseMillis para
+    // que el desbordamiento de millis() (49 días) no descuadre la hora
+    uint32_t timeOfDay(unsigned long now) {
+        uint32_t elapsed = now - baseMillis;
+        if (elapsed >= DAY_MS) {
+            uint32_t days = elapsed / DAY_MS;
+            baseMillis += days * DAY_MS;
+            elapsed -= days * DAY_MS;
+        }
+        return (baseTimeOfDay + elapsed) % DAY_MS;
+    }
+};
@@ -1,101 +1,276 @@
 #include <TFT_eSPI.h>
 #include <BluetoothSerial.h>
-#include <Adafruit_PWMServoDriver.h>
 #include <SPIFFS.h>
 #include <Wire.h>
 #include <SPI.h>
 #include <FS.h>
 
 #include "SystemState.h"
+#include "PWMOutput.h"
+#include "ChannelMap.h"
 #include "RGBController.h"
 #include "AudioController.h"
 #include "BluetoothController.h"
 #include "UIController.h"
 #include "PhaseController.h"
+#include "ProfileLibrary.h"
+#include "LightingEngine.h"
+#include "LoopStats.h"
+#include "AudioInput.h"
+#include "AudioReactive.h"
+#include "FrameClock.h"
+#include "Scheduler.h"
+#include "RelayOutput.h"
+#include "OutputSnapshot.h"
+#include "Log.h"
 
 // Instancias principales
 TFT_eSPI tft;
-Adafruit_PWMServoDriver pwm;
-SystemState systemState;
+// Placas PCA9685 encadenadas desde 0x40 (hasta PWMOutput::MAX_BOARDS)
+static const uint8_t PWM_BOARDS = 1;
+PWMOutput pwmOutput(Wire, PWM_BOARDS);
+ChannelMap channelMap;
+SystemState systemState;   // Propiedad de la tarea de iluminación
+SystemState uiState;       // Copia que lee la tarea de comunicaciones
+LoopStats loopStats;       // Latencias y contadores (comando STATS)
+// Eventos por tiempo de cada tarea; se declaran antes que quien los registra
+Scheduler lightingScheduler;
+Scheduler commsScheduler;
+static const uint8_t COMMS_EVENTS = 3;  // Los de scheduleCommsEvents()
+static_assert(NUM_ZONES * PhaseController::SCHEDULER_EVENTS + OutputSnapshot::SCHEDULER_EVENTS +
+              LightingEngine::SCHEDULER_EVENTS <= Scheduler::MAX_EVENTS,
+              "lightingScheduler no tiene huecos para todas las zonas");
+static_assert(ProfileLibrary::SCHEDULER_EVENTS + COMMS_EVENTS <= Scheduler::MAX_EVENTS,
+              "commsScheduler no tiene huecos para sus eventos");
+RelayOutput relayOutput(systemState, 26, 27);
 
 
 // Instacias
-RGBController rgbController(pwm, systemState);
-AudioController audioController(systemState);
-PhaseController phaseController(systemState, rgbController);
-//UIController uiController(tft, systemState);
+RGBController rgbController(pwmOutput, channelMap, systemState);
+AudioController audioController;
+// Una secuencia por zona (ZONE_LAYOUTS), cada una con su línea de tiempo
+PhaseController phaseZones[NUM_ZONES] = {
+    {systemState, rgbController, relayOutput, lightingScheduler, 0},
+    {systemState, rgbController, relayOutput, lightingScheduler, 1},
+};
+static_assert(NUM_ZONES == 2, "phaseZones[] debe tener una entrada por zona");
+AudioInput audioInput;
+AudioReactive audioReactive(audioInput, rgbController);
+FrameClock frameClock;
+OutputSnapshot outputSnapshot(systemState, rgbController, relayOutput, lightingScheduler);
+LightingEngine lightingEngine(systemState, phaseZones, rgbController, outputSnapshot, audioReactive, frameClock,
+                              loopStats, lightingScheduler);
 
-UIController uiController(tft, systemState, phaseController);
+UIController uiController(tft, uiState, phaseZones, loopStats, audioController);
 
-BluetoothController btController(systemState, rgbController, audioController, phaseController);
+ProfileLibrary profileLibrary(lightingEngine, phaseZones, commsScheduler);
 
-void setup() {
-    Serial.begin(115200);
-    Serial.println("Iniciando sistema...");
+BluetoothController btController(rgbController, audioController, lightingEngine, profileLibrary, loopStats);
+
+// Reparto de núcleos: la iluminación va sola en el APP_CPU; Bluetooth y la
+// pantalla comparten el PRO_CPU con la pila Bluetooth del sistema
+static const BaseType_t LIGHTING_CORE = 1;
+static const BaseType_t COMMS_CORE = 0;
+
+// Eventos periódicos de la tarea de comunicaciones
+void refreshDisplay(void*) {
+    lightingEngine.readSnapshot(uiState);
+    LoopStats::Scope timer(loopStats, LoopStats::DISPLAY);
+    uiController.updateDisplay();
+}
+
+void closeDisplayStats(void*) {
+    uiController.closeStatsWindow();
+}
+
+void printDebug(void*) {
+    LOG_DEBUG("Loop ejecutándose...");
+    const PWMOutput::Stats& i2c = rgbController.getOutputStats();
+    LOG_DEBUG("I2C: %lu transacciones (%lu ahorradas), %lu bytes (%lu ahorrados)",
+              (unsigned long)i2c.transactions, (unsigned long)i2c.savedTransactions(),
+              (unsigned long)i2c.bytesSent, (unsigned long)i2c.savedBytes());
+    LOG_DEBUG("TFT: %lu pixeles/s (%lu bytes SPI/s)",
+              (unsigned long)uiController.getPixelsPerSecond(),
+              (unsigned long)uiController.getSpiBytesPerSecond());
+    const AudioController::Stats& audio = audioController.getStats();
+    LOG_DEBUG("Audio: %s, %lu ordenes, %lu reintentos, %lu fallos",
+              audioController.isLinkUp() ? "enlazado" : "sin enlace",
+              (unsigned long)audio.sent, (unsigned long)audio.retries,
+              (unsigned long)audio.failures);
+    uint16_t lightingDuty = loopStats.dutyCycle(LoopStats::LIGHTING_TASK);
+    uint16_t commsDuty = loopStats.dutyCycle(LoopStats::COMMS_TASK);
+    LOG_DEBUG("Despierta: iluminacion %u.%u%%, comunicaciones %u.%u%%",
+              lightingDuty / 10, lightingDuty % 10, commsDuty / 10, commsDuty % 10);
+}
+
+static const uint32_t DEBUG_INTERVAL_MS = 2000;
 
-    if (!SPIFFS.begin(true)) {
-        Serial.println("Error al montar SPIFFS");
-        return;
+void scheduleCommsEvents() {
+    unsigned long now = millis();
+    commsScheduler.schedule(commsScheduler.add(refreshDisplay, nullptr),
+                            now, UIController::UPDATE_INTERVAL_MS);
+    commsScheduler.schedule(commsScheduler.add(closeDisplayStats, nullptr),
+                            now + UIController::STATS_WINDOW_MS, UIController::STATS_WINDOW_MS);
+    commsScheduler.schedule(commsScheduler.add(printDebug, nullptr),
+                            now + DEBUG_INTERVAL_MS, DEBUG_INTERVAL_MS);
+}
+
+// Una vuelta de la tarea de comunicaciones: Bluetooth y UART se atienden
+// según llegan datos; pantalla y debug, cuando vence su evento. El registro
+// se vacía por Serial sin esperar a la UART.
+void commsStep() {
+    {
+        LoopStats::Scope timer(loopStats, LoopStats::BLUETOOTH);
+        btController.update();
     }
 
-    Wire.begin(21, 22);
-    phaseController.loadFromSPIFFS();
-    rgbController.begin();
-    audioController.begin();
+    {
+        LoopStats::Scope timer(loopStats, LoopStats::AUDIO);
+        audioController.update();
+    }
+
+    commsScheduler.runDue(millis());
+    Log::instance().drain(Serial);
+}
+
+TaskHandle_t commsTaskHandle = nullptr;
+
+// Datos de Bluetooth o del Nano: la tarea deja de dormir
+void wakeComms() {
+    if (commsTaskHandle != nullptr) xTaskNotifyGive(commsTaskHandle);
+}
+
+// ms que puede dormir la tarea de comunicaciones: hasta su próximo evento o
+// el próximo plazo del enlace con el Nano; los datos la despiertan antes.
+// Con registros sin escribir se vuelve cuando la UART haya vaciado la FIFO.
+uint32_t commsIdleTime() {
+    unsigned long now = millis();
+    uint32_t next = commsScheduler.nextDue(now);
+    uint32_t audio = audioController.nextDue(now);
+    if (audio < next) next = audio;
+    if (!Log::instance().isEmpty() && Log::DRAIN_RETRY_MS < next) next = Log::DRAIN_RETRY_MS;
+    return next;
+}
+
+// Lo lento del arranque (pantalla y pila Bluetooth), ya en la tarea de
+// comunicaciones: la iluminación está en marcha mientras tanto
+void commsBegin() {
     uiController.begin();
-    btController.begin();
-    
-    Serial.println("Sistema iniciado correctamente");
+    btController.begin(wakeComms);
+    loopStats.bootStage(LoopStats::BOOT_READY);
+    LOG_INFO("Arranque: luz a los %lu ms, listo a los %lu ms",
+             (unsigned long)loopStats.bootTime(LoopStats::BOOT_FIRST_LIGHT),
+             (unsigned long)loopStats.bootTime(LoopStats::BOOT_READY));
 }
 
-void loop() {
-    static unsigned long lastDebug = 0;
-    
-    btController.update();
-    phaseController.update();
-    uiController.updateDisplay();
+void commsTask(void* param) {
+    commsBegin();
+    for (;;) {
+        commsStep();
+        // Al menos un tick: cede el núcleo (y alimenta el watchdog de la tarea idle)
+        TickType_t ticks = pdMS_TO_TICKS(commsIdleTime());
+        unsigned long start = millis();
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+        loopStats.slept(LoopStats::COMMS_TASK, millis() - start);
+    }
+}
 
-    // Debug periódico
-    if (millis() - lastDebug > 2000) {
-        Serial.println("Loop ejecutándose...");
-        lastDebug = millis();
+void setup() {
+    Serial.begin(115200);
+    LOG_INFO("Iniciando sistema...");
+
+    // Sin SPIFFS se sigue con las fases por defecto
+    bool spiffsReady = SPIFFS.begin(true);
+    if (!spiffsReady) {
+        LOG_ERROR("Error al montar SPIFFS");
     }
-    static unsigned long lastDisplayUpdate = 0;
-    if (millis() - lastDisplayUpdate >= 100) {  // Actualizar cada 100ms
-        uiController.updateDisplay();
-        lastDisplayUpdate = millis();
+
+    // Primero la luz: la última salida guardada (o todo apagado) va a las
+    // placas antes de cargar nada más
+    relayOutput.begin();
+    Wire.begin(21, 22);
+    channelMap.useMirroredLayout(PWM_BOARDS);
+    bool restored = spiffsReady && outputSnapshot.restore();
+    rgbController.begin();  // Pone el bus en Fast-mode Plus (1 MHz)
+    loopStats.bootStage(LoopStats::BOOT_FIRST_LIGHT);
+    LOG_INFO(restored ? "Salida anterior restaurada" : "Sin salida guardada: todo apagado");
+
+    if (spiffsReady) {
+        for (PhaseController& zone : phaseZones) {
+            zone.loadFromSPIFFS();
+        }
+        profileLibrary.begin();
+    }
+    LOG_INFO("PWM: %u placas, %u canales en uso, hasta %lu fps",
+             pwmOutput.getBoardCount(), channelMap.getPhysicalCount(),
+             (unsigned long)PWMOutput::achievableFrameRate(channelMap.getPhysicalCount(),
+                                                           pwmOutput.getBusHz()));
+    audioController.begin(wakeComms);
+    if (!audioInput.begin()) {
+        LOG_ERROR("Error al iniciar la entrada de audio");
     }
+    lightingEngine.begin();
+    lightingEngine.readSnapshot(uiState);
+    scheduleCommsEvents();
+
+    // Pantalla y Bluetooth arrancan en la tarea de comunicaciones
+    // (commsBegin) en paralelo con la de iluminación
+    lightingEngine.startTask(LIGHTING_CORE);
+    xTaskCreatePinnedToCore(commsTask, "comms", 8192, nullptr, 1, &commsTaskHandle, COMMS_CORE);
     
+    LOG_INFO("Sistema iniciado correctamente");
+}
+
+void loop() {
+    // Todo el trabajo está en las tareas creadas en setup()
+    vTaskDelete(NULL);
 }
 
 
 
+// La salida se envía en update() y los fundidos ya no bloquean;
+// en la prueba enviamos los cambios y esperamos a que terminen.
+// Estas pruebas usan RGBController directamente: solo antes de startTask()
+void waitForFades() {
+    rgbController.update();
+    while (rgbController.isFading()) {
+        delay(5);
+        rgbController.update();
+    }
+}
+
 void testRGBAndAuxiliaries() {
     Serial.println("Iniciando prueba de LEDs RGB y auxiliares...");
     
     // Prueba de canales RGB individuales
     Serial.println("Probando RGB1 - Rojo");
     rgbController.setRGBColor(0, 255, 0, 0);
+    rgbController.flush();
     delay(1000);
     
     Serial.println("Probando RGB1 - Verde");
     rgbController.setRGBColor(0, 0, 255, 0);
+    rgbController.flush();
     delay(1000);
     
     Serial.println("Probando RGB1 - Azul");
     rgbController.setRGBColor(0, 0, 0, 255);
+    rgbController.flush();
     delay(1000);
     
     // Prueba de fundido en RGB1
     Serial.println("Probando fundido RGB1");
     rgbController.fadeToColor(0, 255, 255, 0, 2000);  // Amarillo
+    waitForFades();
     delay(1000);
     
     // Repetir para RGB2
     Serial.println("Probando RGB2 - Secuencia similar");
     rgbController.setRGBColor(1, 255, 0, 0);
+    rgbController.flush();
     delay(1000);
     rgbController.fadeToColor(1, 0, 0, 255, 2000);
+    waitForFades();
     delay(1000);
     
     // Prueba de auxiliares
@@ -103,9 +278,11 @@ void testRGBAndAuxiliaries() {
     for (int i = 0; i < 5; i++) {
         Serial.printf("Auxiliar %d - Rampa ascendente\n", i + 1);
         rgbController.fadeAuxiliary(i, 255, 1000);
+        waitForFades();
         delay(500);
         Serial.printf("Auxiliar %d - Rampa descendente\n", i + 1);
         rgbController.fadeAuxiliary(i, 0, 1000);
+        waitForFades();
         delay(500);
     }
     
@@ -117,6 +294,7 @@ void testRGBAndAuxiliaries() {
     for (int i = 0; i < 5; i++) {
         rgbController.setAuxiliary(i, 255);
     }
+    rgbController.flush();
     delay(2000);
     
     // Apagar todo
@@ -125,6 +303,7 @@ void testRGBAndAuxiliaries() {
     for (int i = 0; i < 5; i++) {
         rgbController.setAuxiliary(i, 0);
     }
+    rgbController.flush();
     
     Serial.println("Prueba completada");
 }
@@ -0,0 +1,221 @@
+// Arduino.h - sustituto para el simulador de host
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <string>
+#include <chrono>
+#include <functional>
+#include "SimClock.h"
+#include "SimTrace.h"
+
+typedef uint8_t byte;
+
+inline unsigned long millis() { return SimClock::millis(); }
+inline unsigned long micros() { return (unsigned long)SimClock::micros(); }
+inline void delay(unsigned long ms) { SimClock::advanceMs(ms); }
+inline void delayMicroseconds(unsigned int us) { SimClock::advanceUs(us); }
+inline void yield() {}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define SERIAL_8N1 0x800001c
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) { SimTrace::instance().gpio(pin, value); }
+inline int digitalRead(uint8_t) { return LOW; }
+inline int analogRead(uint8_t) { return 0; }
+
+// Contador de ciclos: tiempo real del host escalado a una CPU de 240 MHz,
+// para que LoopStats mida el coste real del código en el host
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+
+class EspClass {
+public:
+    uint32_t getCycleCount() {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        return (uint32_t)(ns * 240 / 1000);
+    }
+};
+
+inline EspClass ESP;
+
+// String mínimo: el firmware ya no lo usa en el camino de comandos
+class String {
+public:
+    std::string value;
+    String() {}
+    String(const char* text) : value(text) {}
+    String(int number) : value(std::to_string(number)) {}
+    String(unsigned long number) : value(std::to_string(number)) {}
+    const char* c_str() const { return value.c_str(); }
+    unsigned length() const { return value.size(); }
+    String& operator+=(const String& other) { value += other.value; return *this; }
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t length) {
+        for (size_t i = 0; i < length; i++) write(data[i]);
+        return length;
+    }
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n) { return printf("%d", n); }
+    size_t print(unsigned n) { return printf("%u", n); }
+    size_t print(long n) { return printf("%ld", n); }
+    size_t print(unsigned long n) { return printf("%lu", n); }
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buffer, (size_t)n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+    }
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+    virtual int availableForWrite() { return 128; }
+    using Print::write;
+};
+
+// UART: la salida va a stdout solo si el simulador lo pide (--verbose)
+class HardwareSerial : public Stream {
+public:
+    static bool& echo() {
+        static bool value = false;
+        return value;
+    }
+
+    // Puertos por número, para que el simulador conecte dispositivos
+    static HardwareSerial*& port(int uart) {
+        static HardwareSerial* ports[3] = {};
+        return ports[uart];
+    }
+
+    int uart;
+    std::string rx;
+    std::string tx;
+
+    explicit HardwareSerial(int number) : uart(number) { port(number) = this; }
+    std::function<void()> receiveCallback;
+
+    void begin(unsigned long, uint32_t = SERIAL_8N1, int8_t = -1, int8_t = -1) {}
+    void onReceive(std::function<void()> callback) { receiveCallback = callback; }
+    void inject(const std::string& data) {
+        rx += data;
+        if (receiveCallback) receiveCallback();
+    }
+    int available() override { return (int)rx.size(); }
+    int read() override {
+        if (rx.empty()) return -1;
+        int c = (uint8_t)rx[0];
+        rx.erase(0, 1);
+        return c;
+    }
+    // El puerto 0 es la consola; los demás guardan lo escrito en 'tx'
+    size_t write(uint8_t c) override {
+        if (uart != 0) {
+            tx += (char)c;
+        } else if (echo()) {
+            fputc(c, stdout);
+        }
+        return 1;
+    }
+    using Print::write;
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// FreeRTOS: en el simulador no hay tareas; el programa de prueba llama
+// directamente a los pasos de cada tarea con el tiempo virtual
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+#define pdFALSE 0
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    if (handle) *handle = nullptr;
+    return pdTRUE;
+}
+inline TickType_t xTaskGetTickCount() { return SimClock::millis(); }
+inline void vTaskDelay(TickType_t ticks) { SimClock::advanceMs(ticks); }
+inline void vTaskDelayUntil(TickType_t* lastWake, TickType_t period) {
+    *lastWake += period;
+    if (SimClock::millis() < *lastWake) SimClock::advanceMs(*lastWake - SimClock::millis());
+}
+inline void vTaskDelete(TaskHandle_t) {}
+
+// Notificaciones de tarea: un contador común, suficiente para una sola
+// tarea que espera (la de iluminación)
+inline uint32_t& simNotifications() {
+    static uint32_t value = 0;
+    return value;
+}
+// Mientras la tarea duerme con plazo, el simulador ejecuta las demás y
+// avanza el reloj hasta el plazo o hasta que alguien la notifique
+inline std::function<void(TickType_t)>& simSleepHook() {
+    static std::function<void(TickType_t)> hook;
+    return hook;
+}
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+inline void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t* woken) {
+    simNotifications()++;
+    if (woken) *woken = pdTRUE;
+}
+inline void xTaskNotifyGive(TaskHandle_t) { simNotifications()++; }
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    if (simNotifications() == 0 && ticks > 0 && ticks != portMAX_DELAY && simSleepHook()) {
+        simSleepHook()(ticks);
+    }
+    uint32_t value = simNotifications();
+    simNotifications() = clear ? 0 : (value ? value - 1 : 0);
+    return value;
+}
+#define portYIELD_FROM_ISR()
+#define IRAM_ATTR
+
+// Temporizador hardware: el simulador llama él mismo a la interrupción
+struct hw_timer_t {
+    void (*handler)();
+    uint64_t alarm;
+};
+inline hw_timer_t* timerBegin(uint8_t, uint16_t, bool) {
+    static hw_timer_t timer = {};
+    return &timer;
+}
+inline void timerAttachInterrupt(hw_timer_t* timer, void (*handler)(), bool) { timer->handler = handler; }
+inline void timerAlarmWrite(hw_timer_t* timer, uint64_t alarm, bool) { timer->alarm = alarm; }
+inline void timerAlarmEnable(hw_timer_t*) {}
+inline void timerAlarmDisable(hw_timer_t*) {}
+inline void timerWrite(hw_timer_t*, uint64_t) {}
@@ -0,0 +1,58 @@
+// BluetoothSerial.h - sustituto para el simulador de host
+#pragma once
+#include "Arduino.h"
+
+// SPP simulado: el programa de prueba inyecta bytes y lee las respuestas.
+// El firmware tiene su BluetoothSerial como miembro privado, así que el
+// simulador lo localiza con BluetoothSerial::last().
+enum esp_spp_cb_event_t { ESP_SPP_DATA_IND_EVT = 30, ESP_SPP_SRV_OPEN_EVT = 34 };
+struct esp_spp_cb_param_t {};
+typedef void (*esp_spp_cb_t)(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+
+class BluetoothSerial : public Stream {
+public:
+    std::string rx;
+    std::string tx;
+    esp_spp_cb_t callback = nullptr;
+
+    static BluetoothSerial*& last() {
+        static BluetoothSerial* instance = nullptr;
+        return instance;
+    }
+
+    BluetoothSerial() { last() = this; }
+
+    static const unsigned long INIT_MS = 450;   // Controlador y pila Bluedroid
+
+    bool begin(const char*) {
+        delay(INIT_MS);
+        return true;
+    }
+    bool register_callback(esp_spp_cb_t cb) {
+        callback = cb;
+        return true;
+    }
+    // Un cliente abre la conexión SPP
+    void connect() {
+        esp_spp_cb_param_t param;
+        if (callback) callback(ESP_SPP_SRV_OPEN_EVT, &param);
+    }
+    void inject(const std::string& data) {
+        rx += data;
+        esp_spp_cb_param_t param;
+        if (callback) callback(ESP_SPP_DATA_IND_EVT, &param);
+    }
+
+    int available() override { return (int)rx.size(); }
+    int read() override {
+        if (rx.empty()) return -1;
+        int c = (uint8_t)rx[0];
+        rx.erase(0, 1);
+        return c;
+    }
+    size_t write(uint8_t c) override {
+        tx += (char)c;
+        return 1;
+    }
+    using Print::write;
+};
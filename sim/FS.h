@@ -0,0 +1,98 @@
+// FS.h - sustituto para el simulador de host
+#pragma once
+#include "Arduino.h"
+#include "SimAlloc.h"
+
+// Sistema de ficheros sobre un directorio del host. stdio reserva sus
+// buffers y las rutas son std::string: nada de eso cuenta en SimAlloc.
+namespace fs {
+
+class File : public Stream {
+private:
+    FILE* handle = nullptr;
+
+public:
+    File() {}
+    explicit File(FILE* f) : handle(f) {}
+
+    operator bool() const { return handle != nullptr; }
+
+    size_t write(uint8_t c) override {
+        SimAlloc::Pause pause;
+        return fwrite(&c, 1, 1, handle);
+    }
+    size_t write(const uint8_t* data, size_t length) override {
+        SimAlloc::Pause pause;
+        return fwrite(data, 1, length, handle);
+    }
+    using Print::write;
+
+    size_t read(uint8_t* data, size_t length) {
+        SimAlloc::Pause pause;
+        return fread(data, 1, length, handle);
+    }
+    int read() override {
+        SimAlloc::Pause pause;
+        return fgetc(handle);
+    }
+    int available() override { return (int)(size() - position()); }
+
+    size_t position() const { return (size_t)ftell(handle); }
+    bool seek(uint32_t pos) {
+        SimAlloc::Pause pause;
+        return fseek(handle, pos, SEEK_SET) == 0;
+    }
+    size_t size() const {
+        SimAlloc::Pause pause;
+        long current = ftell(handle);
+        fseek(handle, 0, SEEK_END);
+        long end = ftell(handle);
+        fseek(handle, current, SEEK_SET);
+        return (size_t)end;
+    }
+
+    void flush() override { fflush(handle); }
+    void close() {
+        if (handle) fclose(handle);
+        handle = nullptr;
+    }
+};
+
+class FS {
+private:
+    std::string root;
+
+    std::string hostPath(const char* path) const { return root + path; }
+
+public:
+    void setRoot(const std::string& directory) { root = directory; }
+
+    bool begin(bool = false) { return true; }
+
+    File open(const char* path, const char* mode = "r") {
+        SimAlloc::Pause pause;
+        const char* hostMode = "rb";
+        if (strcmp(mode, "w") == 0) hostMode = "wb";
+        else if (strcmp(mode, "a") == 0) hostMode = "ab";
+        else if (strcmp(mode, "r+") == 0) hostMode = "r+b";
+        return File(fopen(hostPath(path).c_str(), hostMode));
+    }
+
+    bool exists(const char* path) {
+        SimAlloc::Pause pause;
+        FILE* f = fopen(hostPath(path).c_str(), "rb");
+        if (f) fclose(f);
+        return f != nullptr;
+    }
+
+    bool remove(const char* path) {
+        SimAlloc::Pause pause;
+        return ::remove(hostPath(path).c_str()) == 0;
+    }
+    bool rename(const char* from, const char* to) {
+        SimAlloc::Pause pause;
+        return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+    }
+};
+
+}  // namespace fs
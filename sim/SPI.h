@@ -0,0 +1,2 @@
+// SPI.h - sustituto para el simulador de host
+#pragma once
@@ -0,0 +1,5 @@
+// SPIFFS.h - sustituto para el simulador de host
+#pragma once
+#include "FS.h"
+
+extern fs::FS SPIFFS;
@@ -0,0 +1,45 @@
+// SimAlloc.h
+#pragma once
+#include <cstdint>
+
+// Cuenta las reservas de memoria dinámica (malloc, new) mientras está
+// activo. sim_main.cpp sustituye malloc y operator new para llamar a
+// record(). Lo que hacen los sustitutos de SPIFFS queda fuera con Pause:
+// en el ESP32 abrir un fichero también reserva y no es parte del firmware.
+class SimAlloc {
+private:
+    static bool& counting() {
+        static bool active = false;
+        return active;
+    }
+
+    static uint64_t& allocations() {
+        static uint64_t count = 0;
+        return count;
+    }
+
+public:
+    class Pause {
+    private:
+        bool wasCounting;
+
+    public:
+        Pause() : wasCounting(counting()) { counting() = false; }
+        ~Pause() { counting() = wasCounting; }
+    };
+
+    static void record() {
+        if (counting()) allocations()++;
+    }
+
+    static void start() {
+        allocations() = 0;
+        counting() = true;
+    }
+
+    // Reservas desde start()
+    static uint64_t stop() {
+        counting() = false;
+        return allocations();
+    }
+};
@@ -0,0 +1,21 @@
+// SimClock.h
+#pragma once
+#include <cstdint>
+
+// Tiempo virtual del simulador. Solo avanza cuando el programa de prueba
+// lo pide (advance) o cuando el código llama a delay().
+class SimClock {
+private:
+    static uint64_t& nowUs() {
+        static uint64_t value = 0;
+        return value;
+    }
+
+public:
+    static uint64_t micros() { return nowUs(); }
+    static uint32_t millis() { return (uint32_t)(nowUs() / 1000); }
+
+    static void advanceUs(uint64_t us) { nowUs() += us; }
+    static void advanceMs(uint32_t ms) { nowUs() += (uint64_t)ms * 1000; }
+    static void reset() { nowUs() = 0; }
+};
@@ -0,0 +1,63 @@
+// SimNano.h - Arduino Nano de audio simulado en el otro extremo de UART2
+#pragma once
+#include "Arduino.h"
+#include "../BinaryProtocol.h"
+
+// Responde a cada orden con un ACK y un estado (reproduciendo, pista,
+// volumen), descartando duplicados por secuencia como el Nano real.
+// Con 'mute' no responde, para probar los reintentos.
+class SimNano {
+    BinaryProtocol::FrameDecoder decoder;
+    int lastSequence = -1;
+    bool playing = false;
+    uint8_t track = 1;
+    uint8_t volume = 20;
+
+    void reply(HardwareSerial& port, uint8_t sequence, uint8_t status) {
+        uint8_t frame[16];
+        BinaryProtocol::buildAck(frame, sequence, status);
+        port.inject(std::string((const char*)frame, BinaryProtocol::ACK_FRAME_SIZE));
+
+        uint8_t payload[3] = {(uint8_t)playing, track, volume};
+        uint16_t size = BinaryProtocol::buildFrame(frame, BinaryProtocol::FRAME_AUDIO_STATUS,
+                                                   sequence, payload, sizeof(payload));
+        port.inject(std::string((const char*)frame, size));
+    }
+
+    void apply() {
+        using namespace BinaryProtocol;
+        const uint8_t* payload = decoder.payloadData();
+        switch (decoder.type()) {
+            case FRAME_AUDIO_PLAY: playing = true; track = payload[0]; break;
+            case FRAME_AUDIO_STOP: playing = false; break;
+            case FRAME_AUDIO_TRACK: track = payload[0]; break;
+            case FRAME_AUDIO_VOLUME: volume = payload[0]; break;
+        }
+    }
+
+public:
+    bool mute = false;
+    uint32_t framesReceived = 0;
+
+    void step() {
+        HardwareSerial* port = HardwareSerial::port(2);
+        if (port == nullptr) return;
+
+        std::string received;
+        received.swap(port->tx);
+        for (char c : received) {
+            if (decoder.feed((uint8_t)c, millis()) != BinaryProtocol::FrameDecoder::FRAME_OK) continue;
+            framesReceived++;
+            if (mute) continue;
+
+            uint8_t sequence = decoder.sequence();
+            if (sequence == lastSequence) {
+                reply(*port, sequence, BinaryProtocol::STATUS_DUPLICATE);
+                continue;
+            }
+            apply();
+            lastSequence = sequence;
+            reply(*port, sequence, BinaryProtocol::STATUS_OK);
+        }
+    }
+};
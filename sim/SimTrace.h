@@ -0,0 +1,66 @@
+// SimTrace.h
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include "SimClock.h"
+
+// Registro de todo lo que el firmware manda al hardware simulado.
+// Con un fichero abierto escribe una línea CSV por evento:
+//   ms,pwm,<dirección>,<canal>,<valor>
+//   ms,tft,<operación>,<x>,<y>,<ancho>,<alto>
+//   ms,gpio,<pin>,<valor>
+// Los contadores se mantienen aunque no haya fichero.
+class SimTrace {
+private:
+    FILE* file = nullptr;
+
+public:
+    uint64_t pwmWrites = 0;
+    uint64_t i2cTransactions = 0;
+    uint64_t i2cBytes = 0;
+    uint64_t drawCalls = 0;
+    uint64_t pixels = 0;
+    uint64_t gpioWrites = 0;
+
+    static SimTrace& instance() {
+        static SimTrace trace;
+        return trace;
+    }
+
+    bool open(const char* path) {
+        file = fopen(path, "w");
+        return file != nullptr;
+    }
+
+    void close() {
+        if (file) fclose(file);
+        file = nullptr;
+    }
+
+    void i2cTransaction(size_t bytes) {
+        i2cTransactions++;
+        i2cBytes += bytes;
+    }
+
+    void pwm(uint8_t address, uint8_t channel, uint16_t value) {
+        pwmWrites++;
+        if (file) {
+            fprintf(file, "%u,pwm,0x%02X,%u,%u\n", SimClock::millis(), address, channel, value);
+        }
+    }
+
+    void draw(const char* op, int32_t x, int32_t y, int32_t w, int32_t h) {
+        drawCalls++;
+        pixels += (uint64_t)(w > 0 ? w : 0) * (h > 0 ? h : 0);
+        if (file) {
+            fprintf(file, "%u,tft,%s,%d,%d,%d,%d\n", SimClock::millis(), op, x, y, w, h);
+        }
+    }
+
+    void gpio(uint8_t pin, uint8_t value) {
+        gpioWrites++;
+        if (file) {
+            fprintf(file, "%u,gpio,%u,%u\n", SimClock::millis(), pin, value);
+        }
+    }
+};
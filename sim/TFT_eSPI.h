@@ -0,0 +1,47 @@
+// TFT_eSPI.h - sustituto para el simulador de host
+#pragma once
+#include "Arduino.h"
+#include "SimTrace.h"
+
+#define TFT_BLACK 0x0000
+#define TFT_WHITE 0xFFFF
+#define TFT_CYAN 0x07FF
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_GREEN 0x07E0
+#define TFT_RED 0xF800
+
+// Pantalla 320x240 con la fuente GLCD (6x8 píxeles por carácter y escala)
+class TFT_eSPI {
+private:
+    uint8_t textSize = 1;
+
+public:
+    static const unsigned long INIT_MS = 120;
+
+    void init() { delay(INIT_MS); }   // Reset y secuencia de arranque del ILI9341
+    void setRotation(uint8_t) {}
+    int16_t width() const { return 320; }
+    int16_t height() const { return 240; }
+
+    void fillScreen(uint32_t) { SimTrace::instance().draw("fillScreen", 0, 0, width(), height()); }
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t) {
+        SimTrace::instance().draw("fillRect", x, y, w, h);
+    }
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t) {
+        SimTrace::instance().draw("hline", x, y, w, 1);
+    }
+
+    void setTextSize(uint8_t size) { textSize = size; }
+    void setTextColor(uint16_t, uint16_t) {}
+    void setTextPadding(uint16_t) {}
+    int16_t textWidth(const char* text) const { return (int16_t)(strlen(text) * 6 * textSize); }
+    int16_t fontHeight() const { return 8 * textSize; }
+
+    int16_t drawString(const char* text, int32_t x, int32_t y) {
+        int16_t w = textWidth(text);
+        SimTrace::instance().draw("text", x, y, w, fontHeight());
+        return w;
+    }
+    int16_t drawString(const String& text, int32_t x, int32_t y) { return drawString(text.c_str(), x, y); }
+};
@@ -0,0 +1,50 @@
+// Wire.h - sustituto para el simulador de host
+#pragma once
+#include "Arduino.h"
+#include "SimTrace.h"
+
+// Bus I2C que interpreta las escrituras a registros de canal del PCA9685
+// (0x06 + 4 * canal, con auto-incremento) y las pasa a SimTrace
+class TwoWire : public Stream {
+private:
+    uint8_t address = 0;
+    uint8_t buffer[128];
+    size_t length = 0;
+
+public:
+    bool begin(int = -1, int = -1, uint32_t = 0) { return true; }
+    void setClock(uint32_t) {}
+
+    void beginTransmission(uint8_t deviceAddress) {
+        address = deviceAddress;
+        length = 0;
+    }
+
+    size_t write(uint8_t c) override {
+        if (length < sizeof(buffer)) buffer[length++] = c;
+        return 1;
+    }
+    using Print::write;
+    size_t write(int c) { return write((uint8_t)c); }
+    size_t write(unsigned int c) { return write((uint8_t)c); }
+    size_t write(long c) { return write((uint8_t)c); }
+    size_t write(unsigned long c) { return write((uint8_t)c); }
+
+    uint8_t endTransmission(bool = true) {
+        SimTrace::instance().i2cTransaction(length);
+        if (length >= 5 && buffer[0] >= 0x06 && buffer[0] < 0x06 + 16 * 4) {
+            uint8_t reg = buffer[0] - 0x06;
+            for (size_t i = 1; i + 4 <= length; i += 4, reg += 4) {
+                uint16_t off = buffer[i + 2] | ((buffer[i + 3] & 0x1F) << 8);
+                SimTrace::instance().pwm(address, reg / 4, off);
+            }
+        }
+        return 0;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    uint8_t requestFrom(uint8_t, uint8_t) { return 0; }
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,79 @@
+// driver/i2s.h - sustituto de host del driver I2S del ESP32 (modo ADC)
+#pragma once
+#include "../Arduino.h"
+#include <cmath>
+#include <functional>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum { I2S_NUM_0 = 0 } i2s_port_t;
+typedef enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_RX = 4,
+    I2S_MODE_ADC_BUILT_IN = 32
+} i2s_mode_t;
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_FMT_ONLY_LEFT = 4 } i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1 } i2s_comm_format_t;
+typedef enum { ADC_UNIT_1 = 1 } adc_unit_t;
+typedef enum { ADC1_CHANNEL_0 = 0 } adc1_channel_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+} i2s_config_t;
+
+// Señal de entrada del simulador: tiempo en segundos -> valor en [-1, 1].
+// Por defecto silencio. Las muestras se generan al ritmo del reloj virtual.
+class SimAudio {
+public:
+    static std::function<double(double)>& signal() {
+        static std::function<double(double)> value = [](double) { return 0.0; };
+        return value;
+    }
+
+    static uint32_t& sampleRate() {
+        static uint32_t value = 0;
+        return value;
+    }
+
+    static uint64_t& consumed() {
+        static uint64_t value = 0;
+        return value;
+    }
+};
+
+inline esp_err_t i2s_driver_install(i2s_port_t, const i2s_config_t* config, int, void*) {
+    SimAudio::sampleRate() = config->sample_rate;
+    SimAudio::consumed() = SimClock::micros() * config->sample_rate / 1000000;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_set_adc_mode(adc_unit_t, adc1_channel_t) { return ESP_OK; }
+inline esp_err_t i2s_adc_enable(i2s_port_t) { return ESP_OK; }
+
+inline esp_err_t i2s_read(i2s_port_t, void* dest, size_t size, size_t* bytesRead, TickType_t) {
+    uint32_t rate = SimAudio::sampleRate();
+    uint64_t available = SimClock::micros() * rate / 1000000 - SimAudio::consumed();
+    size_t count = size / sizeof(uint16_t);
+    if (count > available) count = (size_t)available;
+
+    uint16_t* out = (uint16_t*)dest;
+    for (size_t i = 0; i < count; i++) {
+        double t = (double)SimAudio::consumed()++ / rate;
+        double value = SimAudio::signal()(t);
+        if (value > 1) value = 1;
+        if (value < -1) value = -1;
+        out[i] = (uint16_t)lround(2048 + value * 2047);
+    }
+    *bytesRead = count * sizeof(uint16_t);
+    return ESP_OK;
+}
@@ -0,0 +1,768 @@
+// sim_main.cpp - simulador de host del controlador
+//
+// Compila media.ino y los controladores sin cambios contra los sustitutos de
+// este directorio. El tiempo es virtual: el simulador dispara él mismo la
+// interrupción de FrameClock, ejecuta un tick de iluminación y avanza el
+// reloj un período de frame, así que un día de secuencia se simula en
+// segundos. Las dos tareas duermen como en el ESP32: la de iluminación
+// cuando no hay fundidos (el reloj avanza hasta su plazo o hasta que le
+// llega una orden) y la de comunicaciones hasta commsIdleTime() o hasta
+// que le llegan datos; al final se muestra el tiempo despierta de cada una.
+// Con --fps N se cambia la frecuencia de frames (comando FPS).
+//
+// Con --keyframes N se carga además una línea de tiempo de N keyframes
+// repartidos por el día (KF_INICIO/KF/KF_FIN) en lugar de las cuatro fases.
+// Con --clock H la secuencia se ancla a la hora del día (MODO_RELOJ) y el
+// reloj se pone a las H:00, así que empieza directamente en ese punto.
+// Con --curve C los fundidos usan la curva C (Easing::Curve); comparando
+// el coste por frame con --curve 0 se mide lo que añade la curva.
+// El Nano de audio está simulado (SimNano); --mute-nano lo deja sin
+// responder para ver los reintentos y fallos del enlace.
+// Con --audio HZ la entrada de audio es un tono de HZ hercios y se activa
+// el modo reactivo (MODO_AUDIO,1); al final se comprueba que la banda más
+// alta es la del tono y que el análisis cabe en ANALYSIS_BUDGET_US.
+// Con --live-edit, en mitad del fundido Alba -> Día se cambia el rojo de
+// Día y después la transición de Alba (AJUSTE_FASE), y se comprueba que
+// la salida no salta más de LIVE_EDIT_MAX_STEP en ningún frame.
+// Con --log N el registro arranca en el nivel N (3 = depuración); el coste
+// por frame no debe cambiar, porque el texto se forma en la otra tarea.
+// Con --profiles se guardan dos perfiles (el programa y una variante sin
+// rojo en Día) y se cambia de uno a otro en mitad de Día; se comprueba que
+// los cambios salen de la caché, sin leer /profiles.lib, y que la salida
+// funde sin saltos de más de LIVE_EDIT_MAX_STEP.
+// Con --zones la zona 2 (ZONA,2) recibe una línea de tiempo propia de
+// nubes de una hora mientras la zona 1 sigue el programa del día; se
+// comprueba que cada zona cambia a su ritmo y que la zona 1 no se altera.
+// Con --reboot, al final se lee /output.cfg como tras un corte de luz y se
+// comprueba que coincide con la última salida asentada.
+//
+// Con --bench-gamma N no se simula el día: se miden N frames de fundido
+// de los canales lógicos con el camino de GammaTable (progreso Q16,
+// interpolateLevel y levelTo12Bits) y con una copia del camino anterior
+// (progreso float, interpolate en 8 bits y map() lineal), y se cuentan los
+// pasos de 12 bits de un fundido lento a poca luz con cada uno. Los ciclos
+// son tiempo del host a 240 MHz: sirven para comparar, no son del ESP32.
+//
+// Al final, siempre, cada entrada de la tabla de comandos Bluetooth pasa
+// por processCommand() con valores válidos y con cada error que detecta
+// el parser (campos de más o de menos, fuera de rango, no numéricos), y
+// se comprueba que no se reserva memoria dinámica (SimAlloc). También se
+// comprueba que una conexión nueva o un PING dejan aceptar de nuevo una
+// trama binaria con la secuencia de la última aplicada, y que un fundido
+// más largo que su segmento termina antes del keyframe siguiente.
+//
+// Uso: ./simulator [--days N] [--keyframes N] [--clock H] [--curve C] [--mute-nano] [--audio HZ] [--fps N] [--live-edit] [--log N] [--zones] [--profiles] [--reboot] [--bench-gamma N] [--trace fichero.csv] [--max-frame-ns N] [--stats] [--verbose]
+#include "Arduino.h"
+#include <chrono>
+#include <filesystem>
+
+#include "../media.ino"
+#include "SimNano.h"
+#include "SimAlloc.h"
+
+// Toda reserva pasa por SimAlloc::record(); la de glibc hace el trabajo
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) {
+    SimAlloc::record();
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    SimAlloc::record();
+    return __libc_calloc(count, size);
+}
+void* realloc(void* pointer, size_t size) {
+    SimAlloc::record();
+    return __libc_realloc(pointer, size);
+}
+void free(void* pointer) { __libc_free(pointer); }
+}
+
+void* operator new(size_t size) {
+    SimAlloc::record();
+    void* pointer = __libc_malloc(size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer) noexcept { __libc_free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { __libc_free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { __libc_free(pointer); }
+
+HardwareSerial Serial(0);
+TwoWire Wire;
+fs::FS SPIFFS;
+
+static const uint32_t DAY_MS = 24UL * 60 * 60 * 1000;
+
+// Presupuesto del análisis de un bloque: 10% de los 20 ms entre bloques
+static const uint32_t ANALYSIS_BUDGET_US = 2000;
+
+// Órdenes por Bluetooth a una hora fija de la simulación
+struct TimedCommand {
+    uint32_t atMs;
+    const char* command;
+};
+
+// Ajustes en vivo durante el fundido Alba -> Día (empieza a las 2 h)
+static const TimedCommand LIVE_EDITS[] = {
+    {(2 * 60 + 10) * 60000UL, "AJUSTE_FASE,2,0,0"},        // Rojo de RGB1 en Día
+    {(2 * 60 + 20) * 60000UL, "AJUSTE_FASE,1,12,3600000"}, // Transición de Alba: 30 -> 60 min
+};
+static const uint32_t LIVE_EDIT_MAX_STEP = 32;  // De 4095, en un frame
+
+// Cambios de perfil en mitad de Día: al perfil "frio" (Día sin rojo en
+// RGB1) y de vuelta, con un minuto de fundido cada uno
+static const TimedCommand PROFILE_SWITCHES[] = {
+    {5 * 60 * 60000UL, "PERFIL,USAR,2,60000"},
+    {7 * 60 * 60000UL, "PERFIL,USAR,1,60000"},
+};
+
+// Programa día-noche: Alba 2 h, Día 8 h, Tarde 2 h, Noche 12 h
+static const char* const PROVISIONING[] = {
+    "CONFIG_FASE,1,255,150,50,200,100,50,50,0,0,0,0,7200000,1800000",
+    "CONFIG_FASE,2,255,255,255,255,255,255,255,255,0,0,0,28800000,1800000",
+    "CONFIG_FASE,3,255,200,150,255,180,120,150,0,0,0,0,7200000,1800000",
+    "CONFIG_FASE,4,50,50,150,30,30,100,20,0,0,0,0,43200000,1800000",
+};
+
+static SimNano nano;
+
+// Tarea de comunicaciones: un paso y a dormir hasta commsIdleTime(); los
+// datos la despiertan antes. El tiempo dormido se anota como en commsTask().
+static uint64_t nextCommsUs = 0;
+static uint64_t commsSleepStartUs = 0;
+
+static void runComms() {
+    uint64_t now = SimClock::micros();
+    loopStats.slept(LoopStats::COMMS_TASK, (uint32_t)((now - commsSleepStartUs) / 1000));
+    commsStep();
+    nano.step();
+    uint32_t wait = commsIdleTime();
+    if (HardwareSerial::port(2)->available()) wait = 0;  // Respuesta del Nano
+    if (wait == 0) wait = 1;                              // Un tick como mínimo
+    commsSleepStartUs = SimClock::micros();
+    nextCommsUs = commsSleepStartUs + (uint64_t)wait * 1000;
+}
+
+// Un comando por Bluetooth: despierta a la tarea de comunicaciones
+static void deliverCommand(const char* line) {
+    BluetoothSerial::last()->inject(std::string(line) + "\n");
+    runComms();
+}
+
+// Durante la preparación se ejecuta además un frame para aplicar la orden
+static void sendCommand(const char* line) {
+    deliverCommand(line);
+    lightingEngine.runFrame();
+}
+
+// Línea de tiempo sintética: una rampa de colores con un fundido que ocupa
+// la mitad de cada segmento
+static void uploadKeyframes(int count, int curve) {
+    char line[96];
+    snprintf(line, sizeof(line), "KF_INICIO,%lu", (unsigned long)DAY_MS);
+    sendCommand(line);
+
+    uint32_t step = DAY_MS / count;
+    for (int i = 0; i < count; i++) {
+        uint8_t level = (uint8_t)(i * 255 / count);
+        snprintf(line, sizeof(line), "KF,%lu,%u,%u,%u,%u,%u,%u,%u,%u,0,0,0,%d,%lu,%d",
+                 (unsigned long)(i * step), level, 255 - level, 128, 255 - level, level, 64,
+                 level, 255 - level, i % 4, (unsigned long)(step / 2), curve);
+        sendCommand(line);
+    }
+    sendCommand("KF_FIN");
+}
+
+// Nubes para la zona 2: cuatro keyframes en una hora, que se repite
+static const uint32_t CLOUD_PERIOD_MS = 60UL * 60 * 1000;
+static const char* const CLOUD_TIMELINE[] = {
+    "KF_INICIO,3600000",
+    "KF,0,0,0,0,0,0,200,0,0,180,180,180,0,600000",
+    "KF,900000,0,0,0,0,0,80,0,0,60,60,60,0,600000",
+    "KF,1800000,0,0,0,0,0,220,0,0,200,200,200,0,600000",
+    "KF,2700000,0,0,0,0,0,120,0,0,100,100,100,0,600000",
+    "KF_FIN",
+};
+
+// Una línea de comando: el nombre (y subcomando) de 'spec' y sus campos
+// con el valor mínimo, salvo 'count' campos en total y el campo 'bad'
+// sustituido por 'badText'. Un campo de texto lleva tantas 'A' como valor.
+static void buildCommand(char* line, size_t size, const BluetoothController::CommandSpec& spec, int count,
+                         int bad = -1, const char* badText = nullptr, long value = 0, bool useMax = false) {
+    int length = snprintf(line, size, "%s", spec.name);
+    if (spec.subcommand) length += snprintf(line + length, size - length, ",%s", spec.subcommand);
+    for (int i = 0; i < count; i++) {
+        const BluetoothController::FieldSpec* field = i < spec.fieldCount ? &spec.fields[i] : nullptr;
+        long fieldValue = field ? (useMax ? field->maxValue : field->minValue) : 0;
+        if (i == bad && badText) {
+            length += snprintf(line + length, size - length, ",%s", badText);
+            continue;
+        }
+        if (i == bad) fieldValue = value;
+        if (field && field->text) {
+            line[length++] = ',';
+            for (long c = 0; c < fieldValue && length < (int)size - 1; c++) line[length++] = 'A';
+            line[length] = '\0';
+        } else {
+            length += snprintf(line + length, size - length, ",%ld", fieldValue);
+        }
+    }
+}
+
+// Reservas durante processCommand(); entre líneas un frame vacía la cola
+static uint64_t runCommand(const char* text, uint32_t& lines) {
+    char line[192];
+    snprintf(line, sizeof(line), "%s", text);
+    BluetoothSerial::last()->tx.clear();
+    SimAlloc::start();
+    btController.processCommand(line);
+    uint64_t allocations = SimAlloc::stop();
+    lightingEngine.runFrame();
+    lines++;
+    return allocations;
+}
+
+static uint64_t checkCommandAllocations(uint32_t& lines) {
+    // La salida del sustituto de Bluetooth es un std::string: sitio de sobra
+    BluetoothSerial::last()->tx.reserve(1 << 16);
+    uint8_t logLevel = Log::instance().getLevel();
+
+    // El contador tiene que ver una reserva de verdad
+    void* (*volatile allocate)(size_t) = malloc;
+    SimAlloc::start();
+    free(allocate(16));
+    if (SimAlloc::stop() != 1) {
+        printf("ERROR: SimAlloc no cuenta las reservas\n");
+        return UINT64_MAX;
+    }
+
+    uint64_t allocations = 0;
+    char line[192];
+    uint8_t count;
+    const BluetoothController::CommandSpec* commands = BluetoothController::commandTable(count);
+    for (uint8_t c = 0; c < count; c++) {
+        const BluetoothController::CommandSpec& spec = commands[c];
+        int required = spec.fieldCount - spec.optionalCount;
+
+        buildCommand(line, sizeof(line), spec, spec.fieldCount);
+        allocations += runCommand(line, lines);
+        buildCommand(line, sizeof(line), spec, spec.fieldCount, -1, nullptr, 0, true);
+        allocations += runCommand(line, lines);
+        if (spec.optionalCount > 0) {
+            buildCommand(line, sizeof(line), spec, required);
+            allocations += runCommand(line, lines);
+        }
+        buildCommand(line, sizeof(line), spec, spec.fieldCount + 1);
+        allocations += runCommand(line, lines);
+        if (required > 0) {
+            buildCommand(line, sizeof(line), spec, required - 1);
+            allocations += runCommand(line, lines);
+        }
+        for (int i = 0; i < spec.fieldCount; i++) {
+            const BluetoothController::FieldSpec& field = spec.fields[i];
+            buildCommand(line, sizeof(line), spec, spec.fieldCount, i, nullptr, field.maxValue + 1);
+            allocations += runCommand(line, lines);
+            buildCommand(line, sizeof(line), spec, spec.fieldCount, i, nullptr, field.minValue - 1);
+            allocations += runCommand(line, lines);
+            if (!field.text) {
+                buildCommand(line, sizeof(line), spec, spec.fieldCount, i, "x1");
+                allocations += runCommand(line, lines);
+                buildCommand(line, sizeof(line), spec, spec.fieldCount, i, "");
+                allocations += runCommand(line, lines);
+            }
+        }
+    }
+
+    // Errores anteriores a la tabla
+    allocations += runCommand("NO_EXISTE,1", lines);
+    allocations += runCommand("AUDIO,NO_EXISTE", lines);
+    allocations += runCommand("FASE,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1", lines);
+    allocations += runCommand("PLAY,", lines);
+
+    Log::instance().setLevel(logLevel);
+    return allocations;
+}
+
+// Estado del ACK a una trama binaria con un byte de datos
+static uint8_t sendFrame(uint8_t type, uint8_t sequence, uint8_t value) {
+    uint8_t frame[1 + BinaryProtocol::HEADER_SIZE + 1 + BinaryProtocol::CRC_SIZE];
+    uint16_t size = BinaryProtocol::buildFrame(frame, type, sequence, &value, 1);
+    BluetoothSerial* serial = BluetoothSerial::last();
+    serial->tx.clear();
+    serial->inject(std::string((const char*)frame, size));
+    btController.update();
+    if (serial->tx.size() != BinaryProtocol::ACK_FRAME_SIZE) return 0xFF;
+    return (uint8_t)serial->tx[1 + BinaryProtocol::HEADER_SIZE + 1];
+}
+
+// La misma secuencia es un duplicado dentro de una sesión y no después de
+// reconectar o de un PING. ZONA,0 (todas) no cambia nada.
+static bool checkFrameSessions() {
+    using namespace BinaryProtocol;
+    static const uint8_t SEQUENCE = 7;
+    bool ok = sendFrame(FRAME_ZONE, SEQUENCE, 0) == STATUS_OK;
+    ok = ok && sendFrame(FRAME_ZONE, SEQUENCE, 0) == STATUS_DUPLICATE;
+    BluetoothSerial::last()->connect();
+    ok = ok && sendFrame(FRAME_ZONE, SEQUENCE, 0) == STATUS_OK;
+    ok = ok && sendFrame(FRAME_PING, SEQUENCE, 0) == STATUS_OK;
+    ok = ok && sendFrame(FRAME_ZONE, SEQUENCE, 0) == STATUS_OK;
+    lightingEngine.runFrame();
+    return ok;
+}
+
+// Fundido de 5 s en un segmento de 400 ms: al final del segmento casi ha
+// llegado al destino, no va por el 8 %
+static bool checkLongFade() {
+    static Timeline timeline;
+    Timeline::Keyframe keyframe = {};
+    timeline.clear(1000);
+    keyframe.crossFade = 5000;
+    timeline.insert(keyframe);
+    keyframe.time = 400;
+    timeline.insert(keyframe);
+    Timeline::Sample sample = timeline.sample(399);
+    return sample.segment == 0 && sample.fading && sample.progressQ16 == ((uint64_t)399 << 16) / 400;
+}
+
+// Camino de fundido anterior a GammaTable, copiado tal cual: progreso
+// float, interpolación en 8 bits y map() a 12 bits lineales
+static uint8_t floatInterpolate(uint8_t start, uint8_t end, float progress) {
+    return start + (end - start) * progress;
+}
+
+static uint16_t floatTo12Bits(uint8_t value) {
+    return map(value, 0, 255, 0, 4095);
+}
+
+// Ciclos a 240 MHz desde 'start' (tiempo del host)
+static double cyclesSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() * 240;
+}
+
+static void benchGamma(long frames) {
+    static const uint32_t FADE_MS = 30000;
+    uint8_t from[NUM_LOGICAL_CHANNELS];
+    uint8_t to[NUM_LOGICAL_CHANNELS];
+    for (int c = 0; c < NUM_LOGICAL_CHANNELS; c++) {
+        from[c] = (uint8_t)(c * 37 + 11);
+        to[c] = (uint8_t)(255 - c * 53);
+    }
+    volatile uint32_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (long f = 0; f < frames; f++) {
+        uint32_t elapsed = (uint32_t)(f * 5) % FADE_MS;
+        float progress = (float)elapsed / FADE_MS;
+        uint32_t sum = 0;
+        for (int c = 0; c < NUM_LOGICAL_CHANNELS; c++) {
+            sum += floatTo12Bits(floatInterpolate(from[c], to[c], progress));
+        }
+        sink = sink + sum;
+    }
+    double floatCycles = cyclesSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long f = 0; f < frames; f++) {
+        uint32_t elapsed = (uint32_t)(f * 5) % FADE_MS;
+        uint32_t progress = ((uint64_t)elapsed << 16) / FADE_MS;
+        uint32_t sum = 0;
+        for (int c = 0; c < NUM_LOGICAL_CHANNELS; c++) {
+            sum += GammaTable::levelTo12Bits(GammaTable::interpolateLevel(from[c], to[c], progress));
+        }
+        sink = sink + sum;
+    }
+    double fixedCycles = cyclesSince(start);
+
+    // Fundido de 0 a 10 en 1000 frames: valores de 12 bits distintos
+    uint16_t lastFloat = 0xFFFF, lastFixed = 0xFFFF;
+    uint32_t floatSteps = 0, fixedSteps = 0;
+    for (uint32_t f = 0; f <= 1000; f++) {
+        uint16_t value = floatTo12Bits(floatInterpolate(0, 10, f / 1000.0f));
+        if (value != lastFloat) floatSteps++;
+        lastFloat = value;
+        value = GammaTable::levelTo12Bits(GammaTable::interpolateLevel(0, 10, (f << 16) / 1000));
+        if (value != lastFixed) fixedSteps++;
+        lastFixed = value;
+    }
+
+    printf("Gamma:           %ld frames de %u canales\n", frames, (unsigned)NUM_LOGICAL_CHANNELS);
+    printf("  float + map(): %.1f ciclos/frame, %lu pasos de 0 a 10\n",
+           floatCycles / frames, (unsigned long)floatSteps);
+    printf("  Q16 + CIE:     %.1f ciclos/frame, %lu pasos de 0 a 10\n",
+           fixedCycles / frames, (unsigned long)fixedSteps);
+}
+
+int main(int argc, char** argv) {
+    double days = 1.0;
+    int keyframes = 0;
+    int clockHour = -1;
+    int curve = 0;
+    double audioHz = 0;
+    int fps = 0;
+    const char* tracePath = nullptr;
+    long maxFrameNs = 0;
+    bool printStats = false;
+    bool liveEdit = false;
+    int logLevel = -1;
+    bool zones = false;
+    bool profiles = false;
+    bool reboot = false;
+    long benchFrames = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) days = atof(argv[++i]);
+        else if (strcmp(argv[i], "--keyframes") == 0 && i + 1 < argc) keyframes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) clockHour = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--curve") == 0 && i + 1 < argc) curve = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--mute-nano") == 0) nano.mute = true;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) fps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) audioHz = atof(argv[++i]);
+        else if (strcmp(argv[i], "--bench-gamma") == 0 && i + 1 < argc) benchFrames = atol(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else if (strcmp(argv[i], "--max-frame-ns") == 0 && i + 1 < argc) maxFrameNs = atol(argv[++i]);
+        else if (strcmp(argv[i], "--live-edit") == 0) liveEdit = true;
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) logLevel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--zones") == 0) zones = true;
+        else if (strcmp(argv[i], "--profiles") == 0) profiles = true;
+        else if (strcmp(argv[i], "--reboot") == 0) reboot = true;
+        else if (strcmp(argv[i], "--stats") == 0) printStats = true;
+        else if (strcmp(argv[i], "--verbose") == 0) HardwareSerial::echo() = true;
+        else {
+            fprintf(stderr, "Uso: %s [--days N] [--keyframes N] [--clock H] [--curve C] [--mute-nano] [--audio HZ] [--fps N] [--live-edit] [--log N] [--zones] [--profiles] [--reboot] [--bench-gamma N] [--trace fichero.csv] [--max-frame-ns N] [--stats] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (benchFrames > 0) {
+        benchGamma(benchFrames);
+        return 0;
+    }
+
+    // SPIFFS en un directorio temporal limpio para cada ejecución
+    std::filesystem::path spiffsDir = std::filesystem::temp_directory_path() / "b450_sim_spiffs";
+    std::filesystem::remove_all(spiffsDir);
+    std::filesystem::create_directories(spiffsDir);
+    SPIFFS.setRoot(spiffsDir.string());
+
+    SimTrace& trace = SimTrace::instance();
+    if (tracePath && !trace.open(tracePath)) {
+        fprintf(stderr, "No se puede abrir %s\n", tracePath);
+        return 2;
+    }
+
+    if (logLevel >= 0) Log::instance().setLevel((uint8_t)logLevel);
+    SimClock::reset();
+    setup();
+    commsBegin();   // En el equipo, ya en la tarea de comunicaciones
+    lightingEngine.startFrameClock();
+    for (const char* line : PROVISIONING) {
+        char withCurve[96];
+        snprintf(withCurve, sizeof(withCurve), "%s,%d", line, curve);
+        sendCommand(withCurve);
+    }
+    if (keyframes > 0) {
+        uploadKeyframes(keyframes, curve);
+    }
+    if (clockHour >= 0) {
+        char line[32];
+        snprintf(line, sizeof(line), "HORA,%d,0,0", clockHour % 24);
+        sendCommand("MODO_RELOJ,1");
+        sendCommand(line);
+    }
+    if (zones) {
+        sendCommand("ZONA,2");
+        for (const char* line : CLOUD_TIMELINE) {
+            sendCommand(line);
+        }
+        sendCommand("ZONA,0");
+    }
+    if (profiles) {
+        sendCommand("PERFIL,GUARDAR,1,dia");
+        sendCommand("AJUSTE_FASE,2,0,0");
+        sendCommand("PERFIL,GUARDAR,2,frio");
+        sendCommand("PERFIL,USAR,1,0");
+    }
+    sendCommand("PLAY");
+    if (audioHz > 0) {
+        SimAudio::signal() = [audioHz](double t) { return 0.5 * sin(2 * M_PI * audioHz * t); };
+        sendCommand("MODO_AUDIO,1");
+    }
+    sendCommand("AUDIO,PLAY,3");
+    sendCommand("AUDIO,VOLUMEN,25");
+    if (fps > 0) {
+        char line[16];
+        snprintf(line, sizeof(line), "FPS,%d", fps);
+        sendCommand(line);
+    }
+
+    const uint64_t startUs = SimClock::micros();
+    const uint64_t endUs = startUs + (uint64_t)(days * DAY_MS * 1000.0);
+    loopStats.requestReset();
+    commsSleepStartUs = startUs;
+    nextCommsUs = startUs;
+    size_t nextEdit = 0;
+    const TimedCommand* timed = nullptr;
+    size_t timedCount = 0;
+    if (liveEdit) {
+        timed = LIVE_EDITS;
+        timedCount = sizeof(LIVE_EDITS) / sizeof(LIVE_EDITS[0]);
+    } else if (profiles) {
+        timed = PROFILE_SWITCHES;
+        timedCount = sizeof(PROFILE_SWITCHES) / sizeof(PROFILE_SWITCHES[0]);
+    }
+    uint32_t profileMisses = profileLibrary.getMisses();
+    uint16_t redBeforeReturn = 0;
+
+    // Lo que corre en el otro núcleo mientras tanto: comunicaciones y las
+    // órdenes a hora fija, que llegan por Bluetooth
+    auto runOtherTasks = [&]() {
+        if (nextEdit < timedCount && SimClock::micros() - startUs >= (uint64_t)timed[nextEdit].atMs * 1000) {
+            if (profiles && nextEdit == 1) redBeforeReturn = pwmOutput.get(0);
+            deliverCommand(timed[nextEdit++].command);
+        }
+        if (SimClock::micros() >= nextCommsUs) {
+            runComms();
+        }
+    };
+
+    // La tarea de iluminación duerme: el reloj salta de un evento de las
+    // demás tareas al siguiente hasta el plazo o hasta que la despierten
+    simSleepHook() = [&](TickType_t ticks) {
+        uint64_t until = SimClock::micros() + (uint64_t)ticks * 1000;
+        if (until > endUs) until = endUs;
+        while (simNotifications() == 0 && SimClock::micros() < until) {
+            runOtherTasks();
+            uint64_t next = nextCommsUs < until ? nextCommsUs : until;
+            if (nextEdit < timedCount) {
+                uint64_t editUs = startUs + (uint64_t)timed[nextEdit].atMs * 1000;
+                if (editUs < next) next = editUs;
+            }
+            if (next > SimClock::micros()) SimClock::advanceUs(next - SimClock::micros());
+        }
+    };
+
+    uint64_t totalFrames = 0;
+    uint64_t lightingNs = 0;
+    uint64_t worstFrameNs = 0;
+    uint8_t lastPhase[NUM_ZONES];
+    uint32_t phaseChanges[NUM_ZONES] = {};
+    uint16_t lastKeyframe[NUM_ZONES];
+    uint32_t keyframeChanges[NUM_ZONES] = {};
+    for (uint8_t z = 0; z < NUM_ZONES; z++) {
+        lastPhase[z] = systemState.zones[z].currentPhase;
+        lastKeyframe[z] = systemState.zones[z].currentKeyframe;
+    }
+    uint16_t lastRed = pwmOutput.get(0);
+    uint32_t maxRedStep = 0;
+
+    auto wallStart = std::chrono::steady_clock::now();
+    while (SimClock::micros() < endUs) {
+        FrameClock::onTimer();
+        auto t0 = std::chrono::steady_clock::now();
+        lightingEngine.runTick();
+        totalFrames++;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+        lightingNs += ns;
+        if (ns > worstFrameNs) worstFrameNs = ns;
+
+        for (uint8_t z = 0; z < NUM_ZONES; z++) {
+            const SystemState::Zone& zone = systemState.zones[z];
+            if (zone.currentPhase != lastPhase[z]) {
+                lastPhase[z] = zone.currentPhase;
+                phaseChanges[z]++;
+            }
+            if (zone.currentKeyframe != lastKeyframe[z]) {
+                lastKeyframe[z] = zone.currentKeyframe;
+                keyframeChanges[z]++;
+            }
+        }
+
+        if (timed != nullptr) {
+            uint16_t red = pwmOutput.get(0);
+            uint32_t step = red > lastRed ? red - lastRed : lastRed - red;
+            if (step > maxRedStep) maxRedStep = step;
+            lastRed = red;
+        }
+
+        runOtherTasks();
+        SimClock::advanceUs(frameClock.getPeriodUs());
+    }
+    simSleepHook() = nullptr;
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    trace.close();
+
+    double simSeconds = (SimClock::micros() - startUs) / 1e6;
+    double avgFrameNs = totalFrames ? (double)lightingNs / totalFrames : 0.0;
+
+    printf("Simulado:        %.0f s en %.2f s reales (x%.0f)\n",
+           simSeconds, wallSeconds, wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+    printf("Frames:          %llu a %u Hz (%.1f ns/frame de media, %llu ns el peor), %lu fuera de plazo\n",
+           (unsigned long long)totalFrames, frameClock.getRate(), avgFrameNs,
+           (unsigned long long)worstFrameNs, (unsigned long)frameClock.getStats().missedDeadlines);
+    for (uint8_t z = 0; z < NUM_ZONES; z++) {
+        printf(z == 0 ? "Cambios de fase: " : "        zona %u: ", z + 1);
+        printf("%u (%u de keyframe, %u keyframes)\n",
+               phaseChanges[z], keyframeChanges[z], systemState.zones[z].keyframeCount);
+    }
+    printf("I2C:             %llu transacciones, %llu bytes, %llu escrituras PWM\n",
+           (unsigned long long)trace.i2cTransactions, (unsigned long long)trace.i2cBytes,
+           (unsigned long long)trace.pwmWrites);
+    // Frames alcanzables con todas las placas llenas y cambiando en cada frame
+    printf("PWM max fps:    ");
+    for (uint8_t boards : {1, 4, 8}) {
+        uint16_t channels = boards * PWMOutput::CHANNELS_PER_BOARD;
+        printf(" %u canales: %lu (400 kHz) / %lu (1 MHz);", channels,
+               (unsigned long)PWMOutput::achievableFrameRate(channels, 400000),
+               (unsigned long)PWMOutput::achievableFrameRate(channels, PWMOutput::FAST_MODE_PLUS_HZ));
+    }
+    printf("\n");
+    const AudioController::Stats& audio = audioController.getStats();
+    printf("Audio:           %lu ordenes, %lu reintentos, %lu fallos, pista %u\n",
+           (unsigned long)audio.sent, (unsigned long)audio.retries,
+           (unsigned long)audio.failures, audioController.getCurrentTrack());
+    printf("TFT:             %llu llamadas de dibujo, %llu píxeles\n",
+           (unsigned long long)trace.drawCalls, (unsigned long long)trace.pixels);
+    printf("Despierta:       iluminación %.1f%% (%lu esperas), comunicaciones %.1f%% (%lu esperas)\n",
+           loopStats.dutyCycle(LoopStats::LIGHTING_TASK) / 10.0,
+           (unsigned long)loopStats.sleepCount(LoopStats::LIGHTING_TASK),
+           loopStats.dutyCycle(LoopStats::COMMS_TASK) / 10.0,
+           (unsigned long)loopStats.sleepCount(LoopStats::COMMS_TASK));
+    printf("Log:             %lu registros escritos, %lu perdidos\n",
+           (unsigned long)Log::instance().getWritten(), (unsigned long)Log::instance().getDropped());
+    printf("Relés:           %llu escrituras GPIO, estado final %u; eventos pendientes %u (iluminación) / %u (comunicaciones)\n",
+           (unsigned long long)trace.gpioWrites, relayOutput.get(),
+           lightingScheduler.pending(), commsScheduler.pending());
+    printf("Arranque:        luz a los %lu ms, listo a los %lu ms\n",
+           (unsigned long)loopStats.bootTime(LoopStats::BOOT_FIRST_LIGHT),
+           (unsigned long)loopStats.bootTime(LoopStats::BOOT_READY));
+    printf("Memoria:         SystemState %zu B, PhaseController %zu B por zona, RGBController %zu B, fases por defecto %zu B (flash)\n",
+           sizeof(SystemState), sizeof(PhaseController), sizeof(RGBController), sizeof(DEFAULT_PHASES));
+
+    // Respuesta del comando STATS tal como la vería el cliente Bluetooth
+    if (printStats) {
+        BluetoothSerial::last()->tx.clear();
+        sendCommand("STATS");
+        printf("\n%s", BluetoothSerial::last()->tx.c_str());
+    }
+
+    int status = 0;
+    if (liveEdit) {
+        printf("Ajuste en vivo:  %zu cambios, salto máximo de RGB1 rojo %lu por frame\n",
+               nextEdit, (unsigned long)maxRedStep);
+        if (maxRedStep > LIVE_EDIT_MAX_STEP) {
+            printf("ERROR: salto de %lu supera el límite de %lu\n",
+                   (unsigned long)maxRedStep, (unsigned long)LIVE_EDIT_MAX_STEP);
+            status = 1;
+        }
+    }
+    if (profiles) {
+        printf("Perfiles:        %u cambios, %lu desde memoria, %lu con lectura durante la secuencia, "
+               "salto máximo de RGB1 rojo %lu por frame, rojo en frio %u\n",
+               (unsigned)nextEdit, (unsigned long)profileLibrary.getHits(),
+               (unsigned long)(profileLibrary.getMisses() - profileMisses),
+               (unsigned long)maxRedStep, redBeforeReturn);
+        if (profileLibrary.getMisses() != profileMisses) {
+            printf("ERROR: un cambio de perfil ha tenido que leer el fichero\n");
+            status = 1;
+        }
+        if (maxRedStep > LIVE_EDIT_MAX_STEP) {
+            printf("ERROR: salto de %lu supera el límite de %lu\n",
+                   (unsigned long)maxRedStep, (unsigned long)LIVE_EDIT_MAX_STEP);
+            status = 1;
+        }
+        if (nextEdit == timedCount && redBeforeReturn != 0) {
+            printf("ERROR: el perfil frio no ha llegado a la salida\n");
+            status = 1;
+        }
+    }
+    if (reboot) {
+        // Lo que /output.cfg devolvería tras un corte ahora mismo
+        SystemState before = systemState;
+        bool restored = outputSnapshot.restore();
+        bool same = restored && memcmp(before.rgb, systemState.rgb, sizeof(before.rgb)) == 0 &&
+                    memcmp(before.auxiliary, systemState.auxiliary, sizeof(before.auxiliary)) == 0;
+        printf("Reinicio:        salida guardada %s\n", !restored ? "no" : (same ? "igual a la actual" : "distinta"));
+        if (!same) {
+            printf("ERROR: la salida guardada no es la última salida asentada\n");
+            status = 1;
+        }
+    }
+    if (zones) {
+        // La zona 2 pasa por sus cuatro keyframes cada hora; la zona 1, por
+        // los suyos una vez al día
+        uint32_t expected = (uint32_t)(days * DAY_MS * 4 / CLOUD_PERIOD_MS);
+        uint32_t zone1Expected = (uint32_t)(days * systemState.zones[0].keyframeCount);
+        printf("Zonas:           zona 2 %u cambios de keyframe (se esperan ~%u), zona 1 %u cambios de keyframe\n",
+               keyframeChanges[1], expected, keyframeChanges[0]);
+        if (keyframeChanges[1] + 1 < expected || keyframeChanges[1] > expected + 1) {
+            printf("ERROR: la zona 2 no sigue su línea de tiempo\n");
+            status = 1;
+        }
+        if (keyframeChanges[0] > zone1Expected + 1) {
+            printf("ERROR: la zona 1 cambia al ritmo de la zona 2\n");
+            status = 1;
+        }
+    }
+    if (audioHz > 0) {
+        int strongest = 0;
+        printf("Bandas:         ");
+        for (int b = AudioReactive::BAND_50; b <= AudioReactive::BAND_3200; b++) {
+            uint32_t value = audioReactive.featureValue((AudioReactive::Feature)b);
+            printf(" %lu", (unsigned long)value);
+            if (value > audioReactive.featureValue((AudioReactive::Feature)strongest)) strongest = b;
+        }
+        const LoopStats::Timing& fftTiming = loopStats.timing(LoopStats::AUDIO_ANALYSIS);
+        uint32_t avgUs = fftTiming.count ? LoopStats::cyclesToMicros(fftTiming.totalCycles / fftTiming.count) : 0;
+        uint32_t maxUs = LoopStats::cyclesToMicros(fftTiming.maxCycles);
+        printf("\nFFT:             %lu bloques (%.1f/s), %lu us de media, %lu us el peor\n",
+               (unsigned long)audioReactive.getBlocks(), audioReactive.getBlocks() / simSeconds,
+               (unsigned long)avgUs, (unsigned long)maxUs);
+
+        // Banda de octava esperada: [50 * 2^b, 50 * 2^(b+1)) Hz
+        int expected = (int)floor(log2(audioHz / 50.0));
+        if (expected < AudioReactive::BAND_50) expected = AudioReactive::BAND_50;
+        if (expected > AudioReactive::BAND_3200) expected = AudioReactive::BAND_3200;
+        if (strongest != expected) {
+            printf("ERROR: banda más alta %d, se esperaba %d para %.0f Hz\n", strongest, expected, audioHz);
+            status = 1;
+        }
+        if (avgUs > ANALYSIS_BUDGET_US) {
+            printf("ERROR: análisis de %lu us supera el presupuesto de %lu us\n",
+                   (unsigned long)avgUs, (unsigned long)ANALYSIS_BUDGET_US);
+            status = 1;
+        }
+    }
+
+    uint32_t commandLines = 0;
+    uint64_t commandAllocations = checkCommandAllocations(commandLines);
+    printf("Comandos:        %lu líneas por processCommand, %llu reservas de memoria\n",
+           (unsigned long)commandLines, (unsigned long long)commandAllocations);
+    if (commandAllocations != 0) {
+        printf("ERROR: el intérprete de comandos reserva memoria dinámica\n");
+        status = 1;
+    }
+    if (!checkLongFade()) {
+        printf("ERROR: un fundido más largo que su segmento queda cortado\n");
+        status = 1;
+    }
+    bool sessions = checkFrameSessions();
+    printf("Tramas:          secuencias %s tras reconectar o PING\n", sessions ? "aceptadas" : "rechazadas");
+    if (!sessions) {
+        printf("ERROR: una sesión nueva rechaza la secuencia de la anterior\n");
+        status = 1;
+    }
+
+    if (maxFrameNs > 0 && avgFrameNs > maxFrameNs) {
+        printf("ERROR: coste medio por frame %.1f ns supera el límite de %ld ns\n", avgFrameNs, maxFrameNs);
+        return 1;
+    }
+    return status;
+}